@@ -2,24 +2,21 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string>
-#include <fstream>
-#include <functional>
 #include <filesystem>
-#include <sstream>
 
 #include "maths.h"
 #include "win32-opengl.h"
 #include "opengl-util.h"
 #include "perlin.h"
 #include "shaders.h"
+#include "export.h"
 
 #include "imgui-master/imgui.h"
 #include "imgui-master/imgui_impl_opengl3.h"
 #include "imgui-master/imgui_stdlib.h"
 
-void init_terrain(app_state *state, u32 chunk_tile_length, u32 world_width);
-
 static const u32 MAX_RESOLUTION = 8192;
 static const char *texture_resolutions[6] = { "256", "512", "1024", "2048", "4096", "8192" };
 
@@ -33,168 +30,6 @@ void *my_malloc(app_memory *memory, u64 size)
 	return p;
 }
 
-void init_lod_detail_levels(LODSettings *lod_settings, u32 chunk_tile_length)
-{
-	u32 detail = 1;
-	u32 multiplier = pow(2, lod_settings->detail_multiplier);
-
-	for (u32 i = 0; i < lod_settings->max_details_count; i++) {
-		lod_settings->details[i] = detail;
-		detail *= multiplier;
-	}
-
-	// Find the most LODs possible for the chunk size.
-	for (u32 i = 0; i < lod_settings->max_details_count; i++) {
-		lod_settings->max_available_count = i;
-
-		if (lod_settings->details[i] >= chunk_tile_length) {
-			break;
-		}
-	}
-
-	lod_settings->details_in_use = 1;
-}
-
-static real32 noise(V2 p)
-{
-	return perlin(p);
-}
-
-static float pattern(V2 p)
-{
-	V2 q;
-	V2 a = { 0.f, 0.f };
-	V2 b = { 5.2f, 1.3f };
-	q.x = noise(p + 4.f * a);
-	q.y = noise(p + 4.f * b);
-	return noise(p + q);
-}
-
-static void app_generate_terrain_chunk(
-	app_state *state
-	, Chunk *chunk
-	, bool32 just_lods)
-{
-	if (!just_lods) {
-		for (u32 j = 0; j < state->chunk_vertices_length; j++) {
-			for (u32 i = 0; i < state->chunk_vertices_length; i++) {
-				u32 index = j * state->chunk_vertices_length + i;
-
-				real32 x = state->cur_preset.params.x_offset + (chunk->x + (real32)i / state->cur_preset.params.chunk_tile_length) / state->cur_preset.params.scale;
-				real32 y = state->cur_preset.params.z_offset + (chunk->y + (real32)j / state->cur_preset.params.chunk_tile_length) / state->cur_preset.params.scale;
-
-				real32 total = 0;
-				real32 frequency = 1;
-				real32 amplitude = 1;
-				real32 total_amplitude = 0;
-
-				for (u32 octave = 0; octave < state->cur_preset.params.max_octaves; octave++) {
-					total += (0.5f + noise({ (real32)(frequency * x), (real32)(frequency * y) })) * amplitude;
-					total_amplitude += amplitude;
-					amplitude *= state->cur_preset.params.persistence;
-					frequency *= state->cur_preset.params.lacunarity;
-				}
-
-				real32 octave_result = total / total_amplitude;
-
-				if (octave_result < 0) {
-					octave_result = 0;
-				}
-
-				real32 elevation = ((powf(octave_result, state->cur_preset.params.elevation_power)) * state->cur_preset.params.y_scale * state->cur_preset.params.scale);
-
-				chunk->vertices[index].pos.x = i;
-				chunk->vertices[index].pos.y = elevation;
-				chunk->vertices[index].pos.z = j;
-				chunk->vertices[index].nor = {};
-			}
-		}
-
-		// Calculate normals
-		for (u32 j = 0; j < state->cur_preset.params.chunk_tile_length; j++) {
-			for (u32 i = 0; i < state->cur_preset.params.chunk_tile_length; i++) {
-				u32 index = j * state->cur_preset.params.chunk_tile_length + i;
-
-				u32 v0 = j * state->chunk_vertices_length + i;
-				u32 v1 = v0 + 1;
-				u32 v2 = v0 + (1 * state->chunk_vertices_length);
-				u32 v3 = v2 + 1;
-
-				Vertex *a = &chunk->vertices[v3];
-				Vertex *b = &chunk->vertices[v1];
-				Vertex *c = &chunk->vertices[v0];
-				Vertex *d = &chunk->vertices[v2];
-
-				V3 cp = v3_cross(b->pos - a->pos, c->pos - a->pos);
-				
-				a->nor += cp;
-				b->nor += cp;
-				c->nor += cp;
-
-				cp = v3_cross(a->pos - d->pos, c->pos - d->pos);
-
-				d->nor += cp;
-				a->nor += cp;
-				c->nor += cp;
-			}
-		}
-
-		// // Average sum of normals for each vertex.
-		for (u32 j = 0; j < state->chunk_vertices_length; j++) {
-			for (u32 i = 0; i < state->chunk_vertices_length; i++) {
-				u32 index = j * (state->chunk_vertices_length) + i;
-				chunk->vertices[index].nor = v3_normalise(chunk->vertices[index].nor);
-			}
-		}
-	}
-
-	// Create lods.
-	u64 lod_offset = 0;
-
-	for (u32 lod_detail_index = 0; lod_detail_index < state->lod_settings.max_available_count; lod_detail_index++) {
-		const u32 detail = state->lod_settings.details[lod_detail_index];
-
-		u32 indices_length = state->chunk_vertices_length - detail;
-
-		chunk->lod_data_infos[lod_detail_index].quads_count = 0;
-
-		u32 v0, v1, v2, v3;
-
-		const u32 max_width = state->cur_preset.params.chunk_tile_length;
-		const u32 max_height = state->cur_preset.params.chunk_tile_length;
-
-		// Create mesh for vertices above water
-		for (u32 j = 0; j < indices_length; j += detail) {
-			for (u32 i = 0; i < indices_length; i += detail) {
-				u32 index = j * state->chunk_vertices_length + i;
-
-				v1 = v2 = v3 = 0;
-				v0 = index;
-
-				v1 = v0 + detail;
-				v2 = v0 + (detail * state->chunk_vertices_length);
-				v3 = v2 + detail;
-
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[0] = v3; // Top-right
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[1] = v1; // Bottom-right
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[2] = v0; // Bottom-left
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[3] = v2; // Top-left
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[4] = v3;
-				chunk->lods[lod_offset + chunk->lod_data_infos[lod_detail_index].quads_count].i[5] = v0;
-
-				chunk->lod_data_infos[lod_detail_index].quads_count++;
-			}
-		}
-
-		chunk->lod_data_infos[lod_detail_index].quads = &chunk->lods[lod_offset];
-		chunk->lod_data_infos[lod_detail_index].data_offset = lod_offset;
-
-		lod_offset += chunk->lod_data_infos[lod_detail_index].quads_count;
-	}
-
-	chunk->lod_indices_count = lod_offset * 6;
-}
-
 static u32 create_shader(const char *vertex_shader_source, const char *fragment_shader_source)
 {
 	u32 program_id = glCreateProgram();
@@ -311,847 +146,691 @@ static void app_on_destroy(app_state *state)
 	glDeleteTextures(1, &state->texture_map_data.texture);
 	glDeleteFramebuffers(1, &state->texture_map_data.fbo);
 
-	for (u32 i = 0; i < state->chunk_count; i++) {
-		glDeleteBuffers(1, &state->chunks[i]->ebo);
-		glDeleteBuffers(1, &state->chunks[i]->vbo);
+	for (u32 i = 0; i < state->world.chunk_count; i++) {
+		glDeleteBuffers(1, &state->world.chunks[i]->vbo);
 	}
 
+	glDeleteBuffers(1, &state->world.lod_settings.ebo);
+
+	glDeleteBuffers(1, &state->quadtree.grid_vbo);
+	glDeleteBuffers(1, &state->quadtree.grid_ebo);
+	glDeleteTextures(1, &state->quadtree.height_texture);
+	glDeleteTextures(1, &state->quadtree.normal_texture);
+
 	glDeleteVertexArrays(1, &state->triangle_vao);
 
 	glDeleteBuffers(1, &state->quad_vbo);
 	glDeleteBuffers(1, &state->quad_ebo);
+	glDeleteBuffers(1, &state->tree_instance_vbo);
+	glDeleteBuffers(1, &state->rock_instance_vbo);
 	glDeleteVertexArrays(1, &state->triangle_vao);
 
 	glDeleteProgram(state->terrain_shader.program);
 	glDeleteProgram(state->simple_shader.program);
 	glDeleteProgram(state->water_shader.program);
+	glDeleteProgram(state->depth_shader.program);
+	glDeleteProgram(state->terrain_depth_shader.program);
+	glDeleteProgram(state->quadtree_shader.program);
+
+	job_system_shutdown(&state->jobs);
+}
+
+static void depth_shader_use(DepthShader *shader, real32 *projection, real32 *view)
+{
+	glUseProgram(shader->program);
+	glUniformMatrix4fv(shader->projection, 1, GL_FALSE, projection);
+	glUniformMatrix4fv(shader->view, 1, GL_FALSE, view);
 }
 
-static void terrain_shader_use(app_state *state, real32 *clip)
+// Uses the chunk or quadtree terrain shader, whichever the terrain is drawn with.
+static TerrainShader *terrain_shader_use(app_state *state, real32 *clip)
 {
-	glUseProgram(state->terrain_shader.program);
+	TerrainShader *shader = state->use_quadtree ? &state->quadtree_shader : &state->terrain_shader;
+
+	glUseProgram(shader->program);
+
+	glUniformMatrix4fv(shader->projection, 1, GL_FALSE, state->cur_cam.frustrum);
+	glUniformMatrix4fv(shader->view, 1, GL_FALSE, state->cur_cam.view);
 
-	glUniformMatrix4fv(state->terrain_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
-	glUniformMatrix4fv(state->terrain_shader.view, 1, GL_FALSE, state->cur_cam.view);
+	glUniform4fv(shader->plane, 1, clip);
+	glUniform1i(shader->vertices_length, state->world.chunk_vertices_length);
 
-	glUniform4fv(state->terrain_shader.plane, 1, clip);
+	glUniform1f(shader->ambient_strength, state->cur_preset.params.ambient_strength);
+	glUniform1f(shader->diffuse_strength, state->cur_preset.params.diffuse_strength);
+	glUniform1f(shader->specular_strength, state->cur_preset.params.specular_strength);
+	glUniform1f(shader->gamma_correction, state->cur_preset.params.gamma_correction);
 
-	glUniform1f(state->terrain_shader.ambient_strength, state->cur_preset.params.ambient_strength);
-	glUniform1f(state->terrain_shader.diffuse_strength, state->cur_preset.params.diffuse_strength);
-	glUniform1f(state->terrain_shader.specular_strength, state->cur_preset.params.specular_strength);
-	glUniform1f(state->terrain_shader.gamma_correction, state->cur_preset.params.gamma_correction);
+	glUniform3fv(shader->light_pos, 1, (GLfloat *)(&state->light_pos));
+	glUniform1f(shader->sand_height, state->cur_preset.params.sand_height);
+	glUniform1f(shader->stone_height, state->cur_preset.params.stone_height);
+	glUniform1f(shader->snow_height, state->cur_preset.params.snow_height);
 
-	glUniform3fv(state->terrain_shader.light_pos, 1, (GLfloat *)(&state->light_pos));
-	glUniform1f(state->terrain_shader.sand_height, state->cur_preset.params.sand_height);
-	glUniform1f(state->terrain_shader.stone_height, state->cur_preset.params.stone_height);
-	glUniform1f(state->terrain_shader.snow_height, state->cur_preset.params.snow_height);
+	glUniform3fv(shader->light_colour, 1, (GLfloat *)&state->cur_preset.params.light_colour);
+	glUniform3fv(shader->slope_colour, 1, (GLfloat *)&state->cur_preset.params.slope_colour);
+	glUniform3fv(shader->ground_colour, 1, (GLfloat *)&state->cur_preset.params.ground_colour);
+	glUniform3fv(shader->sand_colour, 1, (GLfloat *)&state->cur_preset.params.sand_colour);
+	glUniform3fv(shader->stone_colour, 1, (GLfloat *)&state->cur_preset.params.stone_colour);
+	glUniform3fv(shader->snow_colour, 1, (GLfloat *)&state->cur_preset.params.snow_colour);
 
-	glUniform3fv(state->terrain_shader.light_colour, 1, (GLfloat *)&state->cur_preset.params.light_colour);
-	glUniform3fv(state->terrain_shader.slope_colour, 1, (GLfloat *)&state->cur_preset.params.slope_colour);
-	glUniform3fv(state->terrain_shader.ground_colour, 1, (GLfloat *)&state->cur_preset.params.ground_colour);
-	glUniform3fv(state->terrain_shader.sand_colour, 1, (GLfloat *)&state->cur_preset.params.sand_colour);
-	glUniform3fv(state->terrain_shader.stone_colour, 1, (GLfloat *)&state->cur_preset.params.stone_colour);
-	glUniform3fv(state->terrain_shader.snow_colour, 1, (GLfloat *)&state->cur_preset.params.snow_colour);
+	glUniform3fv(shader->view_position, 1, (GLfloat *)&state->cur_cam.pos);
 
-	glUniform3fv(state->terrain_shader.view_position, 1, (GLfloat *)&state->cur_cam.pos);
+	glUniform1i(shader->shadow_map, 0);
 
-	glUniform1i(state->terrain_shader.shadow_map, 0);
+	glUniform1f(shader->world_length, (real32)state->world.world_tile_length);
+	glUniform1i(shader->height_map, 2);
+	glUniform1i(shader->normal_map, 3);
+
+	return shader;
 }
 
-static void app_render_chunk(app_state *state, real32 *clip, Chunk *chunk, u32 model_handle)
+static GLenum lod_index_type(const LODSettings *lod_settings)
 {
-	glBindVertexArray(state->triangle_vao);
+	return lod_settings->index_size == sizeof(u16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
 
-	u32 chunk_index = chunk->y * state->cur_preset.params.world_width + chunk->x;
+// Chunk vertices are a height and an octahedral normal, the terrain shaders
+// rebuild x and z from gl_VertexID. Every chunk draws from the shared LOD indices.
+static void app_bind_chunk_buffers(app_state *state, Chunk *chunk)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->world.lod_settings.ebo);
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void *)0);
+	glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, normal));
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, state->chunks[chunk_index]->vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->chunks[chunk_index]->ebo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
+// Picks the coarsest LOD whose height error, projected at the chunk's nearest
+// point to the camera, stays within the pixel tolerance.
+static u32 app_chunk_lod(app_state *state, Chunk *chunk)
+{
+	const LODSettings *lod_settings = &state->world.lod_settings;
+	const real32 chunk_tile_length = (real32)state->cur_preset.params.chunk_tile_length;
 
-	real32 model[16];
-	mat4_identity(model);
-	mat4_translate(model, chunk->x * state->cur_preset.params.chunk_tile_length , 0, chunk->y * state->cur_preset.params.chunk_tile_length);
+	const V3 min = { chunk->x * chunk_tile_length, chunk->min_height, chunk->y * chunk_tile_length };
+	const V3 max = { min.x + chunk_tile_length, chunk->max_height, min.z + chunk_tile_length };
+	const V3 pos = state->cur_cam.pos;
 
-	glUniformMatrix4fv(model_handle, 1, GL_FALSE, model);
+	const real32 dx = pos.x < min.x ? min.x - pos.x : (pos.x > max.x ? pos.x - max.x : 0.f);
+	const real32 dy = pos.y < min.y ? min.y - pos.y : (pos.y > max.y ? pos.y - max.y : 0.f);
+	const real32 dz = pos.z < min.z ? min.z - pos.z : (pos.z > max.z ? pos.z - max.z : 0.f);
+	const real32 distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+	// Pixels per world unit at a distance of 1, matching camera_frustrum.
+	const real32 fov_y = radians(state->cur_cam.fov);
+	const real32 pixels_per_unit = state->window_info.h / (2.f * tanf(fov_y / 2.f));
 
-	// LOD 0 is the highest quality.
+	// LOD 0 is the highest quality, errors only grow with each LOD.
 	u32 chunk_lod_detail = 0;
-	s32 distance = 0;
-
-	// Calculate distance from camera's chunk and use that to index the 
-	// the LOD level data.
-	if (chunk != state->current_chunk) {
-		const u32 dx = chunk->x - state->current_chunk->x;
-		const u32 dy = chunk->y - state->current_chunk->y;
-		distance = sqrtf(dx * dx + dy * dy);
-
-		// Cap the distance to the highest (lowest detail) LOD.
-		if (distance >= state->lod_settings.details_in_use) {
-			distance = state->lod_settings.details_in_use - 1;
+
+	while (chunk_lod_detail + 1 < lod_settings->details_in_use) {
+		const real32 error_pixels = chunk->lod_errors[chunk_lod_detail + 1] * pixels_per_unit;
+
+		if (error_pixels > lod_settings->max_pixel_error * distance) {
+			break;
 		}
 
-		chunk_lod_detail = distance;
+		chunk_lod_detail++;
 	}
 
-	const u32 lod_indices_area = chunk->lod_data_infos[chunk_lod_detail].quads_count * 6;
-	const u64 chunk_offset_in_bytes = chunk->lod_data_infos[chunk_lod_detail].data_offset * sizeof(QuadIndices);
-
-	// Find the offset of the LOD data we want to use be looping through every LOD level
-	// before the one we want and calculating the sum of the total size.
-	glDrawElements(GL_TRIANGLES, lod_indices_area, GL_UNSIGNED_INT, (void *)(chunk_offset_in_bytes));
+	return chunk_lod_detail;
 }
 
-static void simple_shader_use(app_state *state)
+static void app_update_chunk_lods(app_state *state)
 {
-	glUseProgram(state->simple_shader.program);
+	state->chunk_lods.resize(state->world.chunk_count);
 
-	glUniform1f(state->simple_shader.ambient_strength, state->cur_preset.params.ambient_strength);
-	glUniform1f(state->simple_shader.diffuse_strength, state->cur_preset.params.diffuse_strength);
-	glUniform1f(state->simple_shader.gamma_correction, state->cur_preset.params.gamma_correction);
+	for (u32 i = 0; i < state->world.chunk_count; i++) {
+		state->chunk_lods[i] = app_chunk_lod(state, state->world.chunks[i]);
+	}
+}
 
-	glUniform3fv(state->simple_shader.light_pos, 1, (GLfloat *)(&state->light_pos));
-	glUniform3fv(state->simple_shader.light_colour, 1, (GLfloat *)&state->cur_preset.params.light_colour);
+// The chunk's LOD with its edges stitched to any coarser neighbours.
+static void app_chunk_draw_ranges(app_state *state, Chunk *chunk, IndexRange *ranges)
+{
+	const u32 world_width = state->cur_preset.params.world_width;
+	const u32 chunk_index = chunk->y * world_width + chunk->x;
+	const u32 lod = state->chunk_lods[chunk_index];
 
-	glUniformMatrix4fv(state->simple_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
-	glUniformMatrix4fv(state->simple_shader.view, 1, GL_FALSE, state->cur_cam.view);
+	// Chunks on the world's border have nothing to meet.
+	u32 neighbour_lods[LOD_EDGE_COUNT] = { lod, lod, lod, lod };
 
-	glUniform1i(state->simple_shader.shadow_map, 0);
+	if (chunk->y > 0) {
+		neighbour_lods[LOD_EDGE_BOTTOM] = state->chunk_lods[chunk_index - world_width];
+	}
+	if (chunk->x + 1 < world_width) {
+		neighbour_lods[LOD_EDGE_RIGHT] = state->chunk_lods[chunk_index + 1];
+	}
+	if (chunk->y + 1 < world_width) {
+		neighbour_lods[LOD_EDGE_TOP] = state->chunk_lods[chunk_index + world_width];
+	}
+	if (chunk->x > 0) {
+		neighbour_lods[LOD_EDGE_LEFT] = state->chunk_lods[chunk_index - 1];
+	}
+
+	lod_draw_ranges(&state->world.lod_settings, lod, neighbour_lods, ranges);
 }
 
-static void app_render_trunks(app_state *state, u32 model_handle)
+static void app_draw_chunk(app_state *state, Chunk *chunk, const IndexRange *ranges, u32 model_handle)
 {
-	real32 model[16];
-
 	glBindVertexArray(state->triangle_vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, state->trunk->vbos[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->trunk->vbos[1]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
-
-	for (u32 i = 0; i < state->trees_pos.size(); i++) {
-		if (state->trees_pos[i].y < state->cur_preset.params.tree_min_height || state->trees_pos[i].y > state->cur_preset.params.tree_max_height) {
-			continue;
-		}
-
-		const real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
+	u32 chunk_index = chunk->y * state->cur_preset.params.world_width + chunk->x;
 
-		mat4_identity(model);
-		mat4_translate(model, state->trees_pos[i].x, state->trees_pos[i].y, state->trees_pos[i].z);
-		mat4_rotate_x(model, state->trees_rotation[i].x);
-		mat4_rotate_y(model, state->trees_rotation[i].y);
-		mat4_rotate_z(model, state->trees_rotation[i].z);
-		mat4_scale(model, scale, scale, scale);
-		glUniformMatrix4fv(model_handle, 1, GL_FALSE, model);
-		glDrawElements(GL_TRIANGLES, 3 * state->trunk->polygons.size(), GL_UNSIGNED_INT, 0);
-	}
-}
+	app_bind_chunk_buffers(state, state->world.chunks[chunk_index]);
 
-static void app_render_leaves(app_state *state, u32 model_handle)
-{
 	real32 model[16];
+	mat4_identity(model);
+	mat4_translate(model, chunk->x * state->cur_preset.params.chunk_tile_length , 0, chunk->y * state->cur_preset.params.chunk_tile_length);
 
-	glDisable(GL_CULL_FACE);
+	glUniformMatrix4fv(model_handle, 1, GL_FALSE, model);
 
-	glBindBuffer(GL_ARRAY_BUFFER, state->leaves->vbos[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->leaves->vbos[1]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
+	RenderPassStats *stats = &state->pass_stats[state->cur_pass];
 
-	for (u32 i = 0; i < state->trees_pos.size(); i++) {
-		if (state->trees_pos[i].y < state->cur_preset.params.tree_min_height || state->trees_pos[i].y > state->cur_preset.params.tree_max_height) {
-			continue;
-		}
+	for (u32 i = 0; i < LOD_DRAW_RANGES_COUNT; i++) {
+		const IndexRange *range = &ranges[i];
 
-		const real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
+		if (range->count) {
+			stats->draw_calls++;
+			stats->triangles += range->count / 3;
+		}
 
-		mat4_identity(model);
-		mat4_translate(model, state->trees_pos[i].x, state->trees_pos[i].y, state->trees_pos[i].z);
-		mat4_rotate_x(model, state->trees_rotation[i].x);
-		mat4_rotate_y(model, state->trees_rotation[i].y);
-		mat4_rotate_z(model, state->trees_rotation[i].z);
-		mat4_scale(model, scale, scale, scale);
-		glUniformMatrix4fv(model_handle, 1, GL_FALSE, model);
-		glDrawElements(GL_TRIANGLES, 3 * state->leaves->polygons.size(), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, range->count, lod_index_type(&state->world.lod_settings), (void *)(range->offset * state->world.lod_settings.index_size));
 	}
 }
 
-static void app_render_rocks(app_state *state, u32 model_handle)
+static void app_render_chunk(app_state *state, real32 *clip, Chunk *chunk, u32 model_handle)
 {
-	real32 model[16];
-
-	glBindVertexArray(state->triangle_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, state->rock->vbos[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->rock->vbos[1]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
-	
-	glEnable(GL_CULL_FACE);
-
-	// Render rocks.
-	for (u32 i = 0; i < state->rocks_pos.size(); i++) {
-		if (state->rocks_pos[i].y < state->cur_preset.params.rock_min_height || state->rocks_pos[i].y > state->cur_preset.params.rock_max_height) {
-			continue;
-		}
-
-		const real32 scale = state->cur_preset.params.rock_size * state->cur_preset.params.scale;
+	IndexRange ranges[LOD_DRAW_RANGES_COUNT];
+	app_chunk_draw_ranges(state, chunk, ranges);
 
-		mat4_identity(model);
-		mat4_translate(model, state->rocks_pos[i].x, state->rocks_pos[i].y, state->rocks_pos[i].z);
-		mat4_rotate_x(model, state->rocks_rotation[i].x);
-		mat4_rotate_y(model, state->rocks_rotation[i].y);
-		mat4_rotate_z(model, state->rocks_rotation[i].z);
-		mat4_scale(model, scale, scale, scale);
-
-		glUniformMatrix4fv(model_handle, 1, GL_FALSE, model);
-		glDrawElements(GL_TRIANGLES, 3 * state->rock->polygons.size(), GL_UNSIGNED_INT, 0);
-	}
-	// End of features
+	app_draw_chunk(state, chunk, ranges, model_handle);
 }
 
-
-static void generate_trees(app_state *state)
+static void app_render_quadtree(app_state *state, u32 node_handle, u32 morph_handle)
 {
-	// Hardcoded limit
-	if (state->cur_preset.params.tree_count > 10000) {
-		state->cur_preset.params.tree_count = 10000;
-	}
+	TerrainQuadtree *quadtree = &state->quadtree;
 
-	state->trees_pos.clear();
-	state->trees_rotation.clear();
-
-	for (u32 i = 0; i < state->cur_preset.params.tree_count; i++) {
-		real32 x, y, z;
-		x = y = z = -1;
+	glBindVertexArray(state->triangle_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, quadtree->grid_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadtree->grid_ebo);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V2), (void *)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(V2), (void *)0);
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, quadtree->height_texture);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, quadtree->normal_texture);
+	glActiveTexture(GL_TEXTURE0);
 
-		std::uniform_real_distribution<> rotation_distr(0, 360);
+	RenderPassStats *stats = &state->pass_stats[state->cur_pass];
 
-		u32 attempt = 0;
-		while (y < state->cur_preset.params.tree_min_height || y > state->cur_preset.params.tree_max_height) {
-			if (++attempt >= 50) {
-				break;
-			}
+	stats->terrain_culled += quadtree_select(quadtree, state->cur_cam.pos, &state->pass_frustum, &state->quadtree_draws);
 
-			std::uniform_int_distribution<> chunk_index(0, state->world_area - 1);
+	for (const QuadtreeDraw &draw : state->quadtree_draws) {
+		const QuadtreeNode *node = &quadtree->nodes[draw.node];
+		const real32 morph_start = quadtree->morph_starts[node->level];
+		const real32 morph_end = quadtree->ranges[node->level];
 
-			Chunk *chunk = state->chunks[chunk_index(state->rng)];
+		const V4 node_uniform = { (real32)node->x, (real32)node->z, (real32)(1 << node->level), 0.f };
+		glUniform4fv(node_handle, 1, node_uniform.E);
 
-			std::uniform_int_distribution<> vertex_index(0, chunk->vertices_count - 1);
+		// The root never morphs.
+		glUniform2f(morph_handle, morph_start, morph_end > morph_start ? 1.f / (morph_end - morph_start) : 0.f);
 
-			Vertex *v = &chunk->vertices[vertex_index(state->rng)];
-			x = chunk->x * state->cur_preset.params.chunk_tile_length + v->pos.x;
-			y = v->pos.y;
-			z = chunk->y * state->cur_preset.params.chunk_tile_length + v->pos.z;
-		}
+		const IndexRange *range = &quadtree->grid_ranges[draw.quadrant];
+		stats->draw_calls++;
+		stats->triangles += range->count / 3;
 
-		if (attempt < 50) {
-			state->trees_pos.push_back({ x, y, z });
-			state->trees_rotation.push_back({ 0.f, (real32)rotation_distr(state->rng), 0.f });
-		}
+		glDrawElements(GL_TRIANGLES, range->count, GL_UNSIGNED_SHORT, (void *)(range->offset * sizeof(u16)));
 	}
 }
 
-static void generate_rocks(app_state *state)
+// Draws the terrain with the shader from terrain_shader_use, leaving out
+// chunks or quadtree nodes outside the pass's frustum.
+static void app_render_terrain(app_state *state, real32 *clip, u32 model_handle, u32 node_handle, u32 morph_handle)
 {
-	// Hardcoded limit.
-	if (state->cur_preset.params.rock_count > 10000) {
-		state->cur_preset.params.rock_count = 10000;
+	if (state->use_quadtree) {
+		app_render_quadtree(state, node_handle, morph_handle);
+		return;
 	}
 
-	state->rocks_pos.clear();
-	state->rocks_rotation.clear();
+	RenderPassStats *stats = &state->pass_stats[state->cur_pass];
 
-	std::uniform_real_distribution<> rotation_distr(0, 360);
+	for (u32 i = 0; i < state->world.chunk_count; i++) {
+		Chunk *chunk = state->world.chunks[i];
 
-	for (u32 i = 0; i < state->cur_preset.params.rock_count; i++) {
-		real32 x, y, z;
-		x = y = z = -1;
-		Vertex *v = &state->chunks[0]->vertices[0];
-
-		u32 attempt = 0;
-		while (y < state->cur_preset.params.rock_min_height || y > state->cur_preset.params.rock_max_height) {
-			if (++attempt >= 50) {
-				break;
-			}
+		if (!state->chunks_visible[i]) {
+			stats->terrain_culled++;
+			stats->triangles_culled += state->world.lod_settings.data_infos[state->chunk_lods[i]].triangles_count;
+			continue;
+		}
 
-			std::uniform_int_distribution<> chunk_index(0, state->world_area - 1);
+		app_render_chunk(state, clip, chunk, model_handle);
+	}
+}
 
-			Chunk *chunk = state->chunks[chunk_index(state->rng)];
+static void simple_shader_use(app_state *state)
+{
+	glUseProgram(state->simple_shader.program);
 
-			std::uniform_int_distribution<> vertex_index(0, chunk->vertices_count - 1);
+	glUniform1f(state->simple_shader.ambient_strength, state->cur_preset.params.ambient_strength);
+	glUniform1f(state->simple_shader.diffuse_strength, state->cur_preset.params.diffuse_strength);
+	glUniform1f(state->simple_shader.gamma_correction, state->cur_preset.params.gamma_correction);
 
-			v = &chunk->vertices[vertex_index(state->rng)];
-			x = chunk->x * state->cur_preset.params.chunk_tile_length + v->pos.x;
-			y = v->pos.y;
-			z = chunk->y * state->cur_preset.params.chunk_tile_length + v->pos.z;
-		}
+	glUniform3fv(state->simple_shader.light_pos, 1, (GLfloat *)(&state->light_pos));
+	glUniform3fv(state->simple_shader.light_colour, 1, (GLfloat *)&state->cur_preset.params.light_colour);
 
-		if (attempt < 50) {
-			state->rocks_pos.push_back({ x, y, z });
+	glUniformMatrix4fv(state->simple_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
+	glUniformMatrix4fv(state->simple_shader.view, 1, GL_FALSE, state->cur_cam.view);
 
-			state->rocks_rotation.push_back({
-				(acosf(v3_dot(v->nor, { 1, 0, 0 })) * 180.f / (real32)M_PI),
-				(real32)rotation_distr(state->rng),
-				(acosf(v3_dot(v->nor, { 0, 0, 1 })) * 180.f / (real32)M_PI)
-			});
-		}
-	}
+	glUniform1i(state->simple_shader.shadow_map, 0);
 }
 
-static void generate_world(app_state *state, bool32 just_lods = false)
+// Draws the pass's visible instances of obj from instance_vbo, every one with
+// a single call.
+static void app_render_instances(app_state *state, Object *obj, u32 instance_vbo, u32 instance_count, real32 scale, u32 scale_handle)
 {
-	for (u32 j = 0; j < state->cur_preset.params.world_width; j++) {
-		for (u32 i = 0; i < state->cur_preset.params.world_width; i++) {
-			state->generation_threads.push_back(std::thread(app_generate_terrain_chunk, state, state->chunks[j * state->cur_preset.params.world_width + i], just_lods));
-		}
-	}
-
-	for (u32 i = 0; i < state->world_area; i++) {
-		state->generation_threads[i].join();
+	if (!instance_count) {
+		return;
 	}
 
-	state->generation_threads.clear();
+	RenderPassStats *stats = &state->pass_stats[state->cur_pass];
 
 	glBindVertexArray(state->triangle_vao);
 
-	u64 quads_sum = 0;
-	for (u32 j = 0; j < state->cur_preset.params.world_width; j++) {
-		for (u32 i = 0; i < state->cur_preset.params.world_width; i++) {
-			u32 index = j * state->cur_preset.params.world_width + i;
+	glBindBuffer(GL_ARRAY_BUFFER, obj->vbos[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->vbos[1]);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
 
-			Chunk *chunk = state->chunks[index];
+	// The model matrix rows step once per instance, only enabled here so the
+	// terrain and water draws sharing the vao don't read them.
+	glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
 
-			glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
-			glBufferData(GL_ARRAY_BUFFER, chunk->vertices_count * sizeof Vertex, chunk->vertices.data(), GL_STATIC_DRAW);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-			glEnableVertexAttribArray(0);
+	for (u32 row = 0; row < 3; row++) {
+		glEnableVertexAttribArray(2 + row);
+		glVertexAttribPointer(2 + row, 4, GL_FLOAT, GL_FALSE, sizeof(FeatureInstance), (void *)(row * sizeof(V4)));
+		glVertexAttribDivisor(2 + row, 1);
+	}
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->ebo);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunk->lod_indices_count * sizeof(u32), chunk->lods.data(), GL_STATIC_DRAW);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
-			glEnableVertexAttribArray(1);
+	glUniform1f(scale_handle, scale);
+	glDrawElementsInstanced(GL_TRIANGLES, 3 * obj->polygons.size(), GL_UNSIGNED_INT, 0, instance_count);
 
-			quads_sum += chunk->lod_data_infos[0].quads_count;
-		}
+	for (u32 row = 0; row < 3; row++) {
+		glDisableVertexAttribArray(2 + row);
 	}
 
-	generate_trees(state);
-	generate_rocks(state);
+	stats->draw_calls++;
+	stats->triangles += (u64)obj->polygons.size() * instance_count;
 }
 
-static std::string face_string_with_normals(u32 f0, u32 f1, u32 f2)
+static void app_render_trunks(app_state *state, u32 scale_handle)
 {
-	std::stringstream ss;
-	ss << "f " << f0 << "//" << f0 << " " << f1 << "//" << f1 << " " << f2 << "//" << f2 << std::endl;
-	return ss.str();
-}
+	const real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
 
-static std::string face_string_with_uv(u32 f0, u32 f1, u32 f2)
-{
-	std::stringstream ss;
-	ss << "f " << f0 << "/" << f0 << " " << f1 << "/" << f1 << " " << f2 << "/" << f2 << std::endl;
-	return ss.str();
+	app_render_instances(state, state->trunk, state->tree_instance_vbo, state->tree_instance_count, scale, scale_handle);
 }
 
-static std::string face_string_with_normals_and_uv(u32 f0, u32 f1, u32 f2)
+static void app_render_leaves(app_state *state, u32 scale_handle)
 {
-	std::stringstream ss;
-	ss << "f " << f0 << "/" << f0 << "/" << f0 << " " << f1 << "/" << f1 << "/" << f1 << " " << f2 << "/" << f2 << "/" << f2 << std::endl;
-	return ss.str();
+	const real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
+
+	glDisable(GL_CULL_FACE);
+
+	app_render_instances(state, state->leaves, state->tree_instance_vbo, state->tree_instance_count, scale, scale_handle);
 }
 
-static std::string face_string_without_normals(u32 f0, u32 f1, u32 f2)
+static void app_render_rocks(app_state *state, u32 scale_handle)
 {
-	std::stringstream ss;
-	ss << "f " << f0 << " " << f1 << " " << f2 << std::endl;
-	return ss.str();
+	const real32 scale = state->cur_preset.params.rock_size * state->cur_preset.params.scale;
+
+	glEnable(GL_CULL_FACE);
+
+	app_render_instances(state, state->rock, state->rock_instance_vbo, state->rock_instance_count, scale, scale_handle);
 }
 
-static void export_terrain_chunk(app_state *state, std::string path, Chunk *chunk)
+// A cube around each feature's origin that holds the model however it's
+// rotated, and around each chunk's features together.
+static void build_feature_bounds(World *world, FeatureBounds *bounds, const FeatureStore *features, real32 radius)
 {
-	std::string filename = "chunk_" + std::to_string(chunk->y) + "_" + std::to_string(chunk->x) + ".obj";
-	std::ofstream object_file(path + filename, std::ios::out);
-
-	if (object_file.good()) {
-		object_file << "mtllib terrain.mtl" << std::endl;
-		object_file << "usemtl textured" << std::endl;
-		object_file << "o " << filename << std::endl;
-
-		for (u32 vertex = 0; vertex < chunk->vertices_count; vertex++) {
-			Vertex *current_vertex = &chunk->vertices[vertex];
-			// Offset chunk vertices by world position.
-			real32 x = current_vertex->pos.x + chunk->x * (state->cur_preset.params.chunk_tile_length);
-			real32 y = current_vertex->pos.y;
-			real32 z = current_vertex->pos.z + chunk->y * (state->cur_preset.params.chunk_tile_length);
-
-			object_file << "v " << x << " " << y << " " << z;
-			object_file << std::endl;
-		}
+	const V3 extent = { radius, radius, radius };
 
-		if (state->export_settings.texture_map) {
-			for (u32 vertex_row = 0; vertex_row < state->chunk_vertices_length; vertex_row++) {
-				for (u32 vertex_col = 0; vertex_col < state->chunk_vertices_length; vertex_col++) {
-					real32 u = (real32)(chunk->y * state->chunk_vertices_length + vertex_row) / (state->cur_preset.params.world_width * state->chunk_vertices_length);
-					real32 v = (real32)(chunk->x * state->chunk_vertices_length + vertex_col) / (state->cur_preset.params.world_width * state->chunk_vertices_length);
+	box_set_resize(&bounds->boxes, features->count);
+	box_set_resize(&bounds->chunk_boxes, world->world_area);
 
-					object_file << "vt " << u << " " << v << std::endl;
-				}
-			}
-		}
+	for (u32 chunk = 0; chunk < world->world_area; chunk++) {
+		const u32 first = features->chunk_starts[chunk];
+		const u32 last = features->chunk_starts[chunk + 1];
 
-		if (state->export_settings.with_normals) {
-			for (u32 vertex = 0; vertex < chunk->vertices_count; vertex++) {
-				Vertex *current_vertex = &chunk->vertices[vertex];
-				real32 nx = current_vertex->nor.x;
-				real32 ny = current_vertex->nor.y;
-				real32 nz = current_vertex->nor.z;
-				object_file << "vn " << nx << " " << ny << " " << nz << std::endl;
-			}
+		// Chunks without any are skipped before their box is looked at.
+		if (first == last) {
+			continue;
 		}
 
-		std::function<std::string(u32, u32, u32)> face_string_func;
-		face_string_func = face_string_without_normals;
+		V3 chunk_min = feature_position(features, first) - extent;
+		V3 chunk_max = feature_position(features, first) + extent;
 
-		if (state->export_settings.with_normals) {
-			face_string_func = face_string_with_normals;
+		for (u32 i = first; i < last; i++) {
+			const V3 min = feature_position(features, i) - extent;
+			const V3 max = feature_position(features, i) + extent;
+			box_set_store(&bounds->boxes, i, min, max);
 
-			if (state->export_settings.texture_map) {
-				face_string_func = face_string_with_normals_and_uv;
+			for (u32 axis = 0; axis < 3; axis++) {
+				chunk_min.E[axis] = min.E[axis] < chunk_min.E[axis] ? min.E[axis] : chunk_min.E[axis];
+				chunk_max.E[axis] = max.E[axis] > chunk_max.E[axis] ? max.E[axis] : chunk_max.E[axis];
 			}
 		}
-		else if (state->export_settings.texture_map) {
-			face_string_func = face_string_with_uv;
-		}
 
-		u32 num_lods_to_export = 1;
-
-		if (state->export_settings.lods) {
-			num_lods_to_export = state->lod_settings.details_in_use;
-		}
-
-		// Each LOD has a group in that object.
-		for (u32 lod_detail_index = 0; lod_detail_index < num_lods_to_export; lod_detail_index++) {
-			object_file << "g " << filename << "_lod" << lod_detail_index << std::endl;
-
-			const u32 lod_detail = state->lod_settings.details[lod_detail_index];
+		box_set_store(&bounds->chunk_boxes, chunk, chunk_min, chunk_max);
+	}
+}
 
-			u32 num_quads = chunk->lod_data_infos[lod_detail_index].quads_count;
+static void app_update_feature_boxes(app_state *state)
+{
+	const real32 tree_scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
+	const real32 rock_scale = state->cur_preset.params.rock_size * state->cur_preset.params.scale;
 
-			for (u32 index = 0; index <= num_quads; index++) {
-				QuadIndices *current_quad = &chunk->lod_data_infos[lod_detail_index].quads[index];
+	if (state->feature_boxes_dirty || tree_scale != state->tree_bounds.scale) {
+		const real32 trunk_radius = object_radius(state->trunk);
+		const real32 leaves_radius = object_radius(state->leaves);
+		const real32 tree_radius = trunk_radius > leaves_radius ? trunk_radius : leaves_radius;
 
-				u32 f0 = current_quad->i[0] + 1;
-				u32 f1 = current_quad->i[1] + 1;
-				u32 f2 = current_quad->i[2] + 1;
-				object_file << face_string_func(f0, f1, f2);
+		build_feature_bounds(&state->world, &state->tree_bounds, &state->world.trees, tree_radius * tree_scale);
+		state->tree_bounds.scale = tree_scale;
+	}
 
-				u32 f3 = current_quad->i[3] + 1;
-				u32 f4 = current_quad->i[4] + 1;
-				u32 f5 = current_quad->i[5] + 1;
-				object_file << face_string_func(f3, f4, f5);
-			}
-		}
+	if (state->feature_boxes_dirty || rock_scale != state->rock_bounds.scale) {
+		build_feature_bounds(&state->world, &state->rock_bounds, &state->world.rocks, object_radius(state->rock) * rock_scale);
+		state->rock_bounds.scale = rock_scale;
 	}
+
+	state->feature_boxes_dirty = false;
 }
 
-static void export_terrain_one_obj(app_state *state, std::string path)
+// Culls a feature store a chunk at a time, then gathers the instances inside
+// the height band that are visible and uploads them for the pass. Returns how
+// many there are. A chunk outside the frustum counts all its features culled.
+static u32 app_cull_features(app_state *state, const FeatureStore *features, const FeatureBounds *bounds, u32 vbo, u32 min_height, u32 max_height, u32 *culled)
 {
-	std::ofstream object_file(path + "terrain.obj", std::ios::out);
-
-	if (object_file.good()) {
-		object_file << "mtllib terrain.mtl" << std::endl;
-		object_file << "usemtl textured" << std::endl;
-		object_file << "o Terrain" << std::endl;
-
-		for (u32 chunk_z = 0; chunk_z < state->cur_preset.params.world_width; chunk_z++) {
-			for (u32 chunk_x = 0; chunk_x < state->cur_preset.params.world_width; chunk_x++) {
-				u32 chunk_index = chunk_z * state->cur_preset.params.world_width + chunk_x;
+	state->visible_instances.clear();
+	state->feature_chunks_visible.resize(bounds->chunk_boxes.count);
+	state->features_visible.resize(features->count);
 
-				object_file << "# Chunk" << chunk_index << " vertices" << std::endl;
+	frustum_cull_boxes(&state->pass_frustum, &bounds->chunk_boxes, state->feature_chunks_visible.data());
 
-				for (u32 vertex = 0; vertex < state->chunks[chunk_index]->vertices_count; vertex++) {
-					Vertex *current_vertex = &state->chunks[chunk_index]->vertices[vertex];
-					// Offset chunk vertices by world position.
-					real32 x = current_vertex->pos.x + chunk_x * (state->cur_preset.params.chunk_tile_length);
-					real32 y = current_vertex->pos.y;
-					real32 z = current_vertex->pos.z + chunk_z * (state->cur_preset.params.chunk_tile_length);
+	for (u32 chunk = 0; chunk < state->world.world_area; chunk++) {
+		const u32 first = features->chunk_starts[chunk];
+		const u32 last = features->chunk_starts[chunk + 1];
 
-					object_file << "v " << x << " " << y << " " << z;
-					object_file << std::endl;
-				}
-			}
-		}
-
-		if (state->export_settings.texture_map) {
-			for (u32 chunk_z = 0; chunk_z < state->cur_preset.params.world_width; chunk_z++) {
-				for (u32 chunk_x = 0; chunk_x < state->cur_preset.params.world_width; chunk_x++) {
-					for (u32 vertex_row = 0; vertex_row < state->chunk_vertices_length; vertex_row++) {
-						for (u32 vertex_col = 0; vertex_col < state->chunk_vertices_length; vertex_col++) {
-							real32 u = (real32)(chunk_z * state->chunk_vertices_length + vertex_row) / (state->cur_preset.params.world_width * state->chunk_vertices_length);
-							real32 v = (real32)(chunk_x * state->chunk_vertices_length + vertex_col) / (state->cur_preset.params.world_width * state->chunk_vertices_length);
-
-							object_file << "vt " << u << " " << v << std::endl;
-						}
-					}
-				}
-			}
+		if (first == last) {
+			continue;
 		}
 
-		if (state->export_settings.with_normals) {
-			for (u32 chunk_z = 0; chunk_z < state->cur_preset.params.world_width; chunk_z++) {
-				for (u32 chunk_x = 0; chunk_x < state->cur_preset.params.world_width; chunk_x++) {
-					u32 chunk_index = chunk_z * state->cur_preset.params.world_width + chunk_x;
-
-					for (u32 vertex = 0; vertex < state->chunks[chunk_index]->vertices_count; vertex++) {
-						Vertex *current_vertex = &state->chunks[chunk_index]->vertices[vertex];
-						real32 nx = current_vertex->nor.x;
-						real32 ny = current_vertex->nor.y;
-						real32 nz = current_vertex->nor.z;
-						object_file << "vn " << nx << " " << ny << " " << nz << std::endl;
-					}
-				}
-			}
+		if (!state->feature_chunks_visible[chunk]) {
+			*culled += last - first;
+			continue;
 		}
 
-		std::function<std::string(u32, u32, u32)> face_string_func;
-		face_string_func = face_string_without_normals;
+		frustum_cull_box_range(&state->pass_frustum, &bounds->boxes, first, last - first, state->features_visible.data());
 
-		if (state->export_settings.with_normals) {
-			face_string_func = face_string_with_normals;
+		for (u32 i = first; i < last; i++) {
+			const real32 y = features->y[i];
 
-			if (state->export_settings.texture_map) {
-				face_string_func = face_string_with_normals_and_uv;
+			if (y < min_height || y > max_height) {
+				continue;
 			}
-		}
-		else if (state->export_settings.texture_map) {
-			face_string_func = face_string_with_uv;
-		}
-
-		for (u32 chunk_z = 0; chunk_z < state->cur_preset.params.world_width; chunk_z++) {
-			for (u32 chunk_x = 0; chunk_x < state->cur_preset.params.world_width; chunk_x++) {
-				u32 chunk_index = chunk_z * state->cur_preset.params.world_width + chunk_x;
 
-				Chunk *current_chunk = state->chunks[chunk_index];
+			if (!state->features_visible[i]) {
+				(*culled)++;
+				continue;
+			}
 
-				u32 num_lods_to_export = 1;
+			state->visible_instances.push_back(features->instances[i]);
+		}
+	}
 
-				if (state->export_settings.lods) {
-					num_lods_to_export = state->lod_settings.details_in_use;
-				}
+	// Orphaned each pass so the driver doesn't wait on the last pass's draws.
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, state->visible_instances.size() * sizeof(FeatureInstance), state->visible_instances.data(), GL_STREAM_DRAW);
 
-				// Each LOD has a group in that object.
-				for (u32 lod_detail_index = 0; lod_detail_index < num_lods_to_export; lod_detail_index++) {
-					object_file << "g Chunk" << chunk_index << "LOD" << lod_detail_index << std::endl;
+	return (u32)state->visible_instances.size();
+}
 
-					const u32 lod_detail = state->lod_settings.details[lod_detail_index];
+// Culls the chunks and features against a pass's projection times view and
+// its clip plane, the render functions then draw only what's visible and
+// count into its stats. Chunks wholly above the water never reach the
+// refraction, wholly below it never reach the reflection.
+static void app_begin_pass(app_state *state, RenderPass pass, const real32 *view_projection, const real32 *clip)
+{
+	state->cur_pass = pass;
+	state->pass_stats[pass] = {};
 
-					u32 num_quads = current_chunk->lod_data_infos[lod_detail_index].quads_count;
+	frustum_from_matrix(&state->pass_frustum, view_projection);
+	frustum_add_plane(&state->pass_frustum, { clip[0], clip[1], clip[2], clip[3] });
 
-					for (u32 index = 0; index <= num_quads; index++) {
-						QuadIndices *current_quad = &current_chunk->lod_data_infos[lod_detail_index].quads[index];
-						u64 chunk_vertices_number_offset = chunk_index * state->chunks[chunk_index]->vertices_count;
+	state->chunks_visible.resize(state->world.chunk_boxes.count);
+	frustum_cull_boxes(&state->pass_frustum, &state->world.chunk_boxes, state->chunks_visible.data());
 
-						u32 f0 = current_quad->i[0] + 1 + chunk_vertices_number_offset;
-						u32 f1 = current_quad->i[1] + 1 + chunk_vertices_number_offset;
-						u32 f2 = current_quad->i[2] + 1 + chunk_vertices_number_offset;
-						object_file << face_string_func(f0, f1, f2);
+	const world_generation_parameters *params = &state->cur_preset.params;
+	RenderPassStats *stats = &state->pass_stats[pass];
+	u32 trees_culled = 0, rocks_culled = 0;
 
-						u32 f3 = current_quad->i[3] + 1 + chunk_vertices_number_offset;
-						u32 f4 = current_quad->i[4] + 1 + chunk_vertices_number_offset;
-						u32 f5 = current_quad->i[5] + 1 + chunk_vertices_number_offset;
-						object_file << face_string_func(f3, f4, f5);
-					}
-				}
-			}
-		}
-	}
+	state->tree_instance_count = app_cull_features(state, &state->world.trees, &state->tree_bounds, state->tree_instance_vbo, params->tree_min_height, params->tree_max_height, &trees_culled);
+	state->rock_instance_count = app_cull_features(state, &state->world.rocks, &state->rock_bounds, state->rock_instance_vbo, params->rock_min_height, params->rock_max_height, &rocks_culled);
 
-	object_file.close();
+	stats->features_culled += trees_culled + rocks_culled;
+	stats->triangles_culled += (u64)trees_culled * (state->trunk->polygons.size() + state->leaves->polygons.size());
+	stats->triangles_culled += (u64)rocks_culled * state->rock->polygons.size();
 }
 
-static void export_terrain(app_state *state)
+static ShadowMapKey shadow_map_key(app_state *state)
 {
-	auto t = std::time(nullptr);
-	auto tm = *std::localtime(&t);
-	std::ostringstream oss;
-	oss << std::put_time(&tm, "%d-%m-%y-%H-%M-%S");
-
-	const std::string path = "./export/" + state->cur_preset.name + "-" + oss.str() + "/";
-
-	std::filesystem::create_directory("./export"); // If it somehow gets deleted.
-	std::filesystem::create_directory(path);
+	const world_generation_parameters *params = &state->cur_preset.params;
+
+	ShadowMapKey key = {};
+	key.light_pos = state->light_pos;
+	key.tree_scale = params->tree_size * params->scale;
+	key.rock_scale = params->rock_size * params->scale;
+	key.tree_min_height = params->tree_min_height;
+	key.tree_max_height = params->tree_max_height;
+	key.rock_min_height = params->rock_min_height;
+	key.rock_max_height = params->rock_max_height;
+
+	return key;
+}
 
-	if (state->export_settings.seperate_chunks) {
-		for (u32 j = 0; j < state->cur_preset.params.world_width; j++) {
-			for (u32 i = 0; i < state->cur_preset.params.world_width; i++) {
-				state->generation_threads.push_back(std::thread(export_terrain_chunk, state, path, state->chunks[j * state->cur_preset.params.world_width + i]));
-			}
-		}
+static bool32 shadow_map_key_equal(const ShadowMapKey *a, const ShadowMapKey *b)
+{
+	return a->light_pos.x == b->light_pos.x
+		&& a->light_pos.y == b->light_pos.y
+		&& a->light_pos.z == b->light_pos.z
+		&& a->tree_scale == b->tree_scale
+		&& a->rock_scale == b->rock_scale
+		&& a->tree_min_height == b->tree_min_height
+		&& a->tree_max_height == b->tree_max_height
+		&& a->rock_min_height == b->rock_min_height
+		&& a->rock_max_height == b->rock_max_height;
+}
 
-		for (u32 i = 0; i < state->world_area; i++) {
-			state->generation_threads[i].join();
-		}
+// Renders the shadow map from the light's POV when the light or anything that
+// casts shadows has changed, otherwise the last one is kept. Chunks are drawn
+// at full detail rather than the camera's LODs so the map doesn't depend on
+// where the camera is.
+static void app_update_shadow_map(app_state *state, real32 *light_projection, real32 *light_view, real32 *light_space_matrix)
+{
+	const ShadowMapKey key = shadow_map_key(state);
 
-		state->generation_threads.clear();
-	}
-	else {
-		export_terrain_one_obj(state, path);
+	if (!state->shadow_map_dirty && shadow_map_key_equal(&state->shadow_map_key, &key)) {
+		state->pass_stats[RENDER_PASS_SHADOW] = {};
+		state->shadow_map_reuses++;
+		return;
 	}
 
-	// Export trees & rocks.
-	if (state->export_settings.trees) {
-		std::ofstream trunks_file(path + "tree_trunks.obj", std::ios::out);
-		
-		if (trunks_file.good()) {
-			trunks_file << "mtllib tree_trunks.mtl" << std::endl;
-			trunks_file << "usemtl colour" << std::endl;
-			
-			u32 i = 0;
-			u32 vertex_offset = 0;
-			for (auto &p : state->trees_pos) {
-				trunks_file << "o Tree_" << i++ << std::endl;
-				for (auto &v : state->trunk->vertices) {
-					V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
-					V4 d = {};
-					real32 m[16];
-					mat4_identity(m);
-
-					real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
-					mat4_scale(m, scale, scale, scale);
-					mat4_rotate_y(m, state->trees_rotation[i].y);
-					
-					for (u32 i = 0; i < 4; i++) {
-						for (u32 j = 0; j < 4; j++) {
-							d.E[i] += (m[i * 4 + j] * v4.E[j]);
-						}
-					}
+	real32 no_clip[4] = { 0, -1, 0, 100000 };
 
-					const real32 x = d.x + p.x;
-					const real32 y = d.y + p.y;
-					const real32 z = d.z + p.z;
-					trunks_file << "v " << x << " " << " " << y << " " << z << std::endl;
-				}
+	glViewport(0, 0, 4096, 4096);
+	glBindFramebuffer(GL_FRAMEBUFFER, state->depth_map_fbo);
+	glClear(GL_DEPTH_BUFFER_BIT);
 
-				for (auto &v : state->trunk->vertices) {
-					const real32 x = v->nor.x;
-					const real32 y = v->nor.y;
-					const real32 z = v->nor.z;
-					trunks_file << "vn " << x << " " << " " << y << " " << z << std::endl;
-				}
+	app_begin_pass(state, RENDER_PASS_SHADOW, light_space_matrix, no_clip);
 
-				for (auto f : state->trunk->polygons) {
-					const u32 f0 = f->indices[0] + 1 + vertex_offset;
-					const u32 f1 = f->indices[1] + 1 + vertex_offset;
-					const u32 f2 = f->indices[2] + 1 + vertex_offset;
-					trunks_file << face_string_with_normals_and_uv(f0, f1, f2);
-				}
+	RenderPassStats *stats = &state->pass_stats[RENDER_PASS_SHADOW];
 
-				vertex_offset += state->trunk->vertices.size();
-			}
+	depth_shader_use(&state->terrain_depth_shader, light_projection, light_view);
+	glUniform1i(state->terrain_depth_shader.vertices_length, state->world.chunk_vertices_length);
 
-			std::ofstream trunk_material_file(path + "tree_trunks.mtl", std::ios::out);
-
-			if (trunk_material_file.good()) {
-				std::string colour_string = std::to_string(state->cur_preset.params.trunk_colour.x) + " "
-					+ std::to_string(state->cur_preset.params.trunk_colour.y) + " "
-					+ std::to_string(state->cur_preset.params.trunk_colour.z);
+	glCullFace(GL_FRONT);
 
-				trunk_material_file << "newmtl colour" << std::endl;
-				trunk_material_file << "Ka " << colour_string << std::endl;
-				trunk_material_file << "Kd " << colour_string << std::endl;
-				trunk_material_file << "Ks 0.000 0.000 0.000" << std::endl;
-				trunk_material_file << "d 1.000" << std::endl;
-				trunk_material_file << "illum 2" << std::endl;
-			}
+	IndexRange ranges[LOD_DRAW_RANGES_COUNT];
+	lod_draw_ranges(&state->world.lod_settings, 0, 0, ranges);
 
-			trunk_material_file.close();
+	for (u32 i = 0; i < state->world.chunk_count; i++) {
+		if (!state->chunks_visible[i]) {
+			stats->terrain_culled++;
+			stats->triangles_culled += state->world.lod_settings.data_infos[0].triangles_count;
+			continue;
 		}
 
-		trunks_file.close();
+		app_draw_chunk(state, state->world.chunks[i], ranges, state->terrain_depth_shader.model);
+	}
 
-		std::ofstream leaves_file(path + "tree_leaves.obj", std::ios::out);
+	glCullFace(GL_BACK);
 
-		if (leaves_file.good()) {
-			leaves_file << "mtllib tree_leaves.mtl" << std::endl;
-			leaves_file << "usemtl colour" << std::endl;
+	depth_shader_use(&state->depth_shader, light_projection, light_view);
 
-			u32 i = 0;
-			u32 vertex_offset = 0;
-			for (auto &p : state->trees_pos) {
-				leaves_file << "o Leaves_" << i++ << std::endl;
-				for (auto &v : state->leaves->vertices) {
-					V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
-					V4 d = {};
-					real32 m[16];
-					mat4_identity(m);
+	app_render_trunks(state, state->depth_shader.instance_scale);
+	app_render_leaves(state, state->depth_shader.instance_scale);
+	app_render_rocks(state, state->depth_shader.instance_scale);
 
-					real32 scale = state->cur_preset.params.tree_size * state->cur_preset.params.scale;
-					mat4_scale(m, scale, scale, scale);
-					mat4_rotate_y(m, state->trees_rotation[i].y);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, state->window_info.w, state->window_info.h);
 
-					for (u32 i = 0; i < 4; i++) {
-						for (u32 j = 0; j < 4; j++) {
-							d.E[i] += (m[i * 4 + j] * v4.E[j]);
-						}
-					}
+	state->shadow_map_key = key;
+	state->shadow_map_dirty = false;
+	state->shadow_map_renders++;
+}
 
-					const real32 x = d.x + p.x;
-					const real32 y = d.y + p.y;
-					const real32 z = d.z + p.z;
-					leaves_file << "v " << x << " " << " " << y << " " << z << std::endl;
-				}
+// The LOD indices are the same for every chunk so they're uploaded once, and
+// again only when the chunk size or detail multiplier changes.
+static void upload_lod_indices(app_state *state)
+{
+	LODSettings *lod_settings = &state->world.lod_settings;
 
-				for (auto &v : state->leaves->vertices) {
-					const real32 x = v->nor.x;
-					const real32 y = v->nor.y;
-					const real32 z = v->nor.z;
-					leaves_file << "vn " << x << " " << " " << y << " " << z << std::endl;
-				}
+	if (!lod_settings->ebo) {
+		glGenBuffers(1, &lod_settings->ebo);
+	}
 
-				for (auto f : state->leaves->polygons) {
-					const u32 f0 = f->indices[0] + 1 + vertex_offset;
-					const u32 f1 = f->indices[1] + 1 + vertex_offset;
-					const u32 f2 = f->indices[2] + 1 + vertex_offset;
-					leaves_file << face_string_with_normals_and_uv(f0, f1, f2);
-				}
+	glBindVertexArray(state->triangle_vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_settings->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod_settings->indices_count * lod_settings->index_size, lod_indices_data(lod_settings), GL_STATIC_DRAW);
+}
 
-				vertex_offset += state->leaves->vertices.size();
-			}
+static u32 create_map_texture(GLint internal_format, GLenum format, GLenum type, u32 length, const void *pixels)
+{
+	u32 tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, length, length, 0, format, type, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
 
-			std::ofstream leaves_material_file(path + "tree_leaves.mtl", std::ios::out);
+// Rebuilds the quadtree from the chunks and uploads its maps. The grid mesh
+// never changes so it's only uploaded the first time.
+static void upload_quadtree(app_state *state)
+{
+	TerrainQuadtree *quadtree = &state->quadtree;
 
-			if (leaves_material_file.good()) {
-				std::string colour_string = std::to_string(state->cur_preset.params.leaves_colour.x) + " "
-					+ std::to_string(state->cur_preset.params.leaves_colour.y) + " "
-					+ std::to_string(state->cur_preset.params.leaves_colour.z);
+	build_quadtree(&state->world, quadtree);
 
-				leaves_material_file << "newmtl colour" << std::endl;
-				leaves_material_file << "Ka " << colour_string << std::endl;
-				leaves_material_file << "Kd " << colour_string << std::endl;
-				leaves_material_file << "Ks 0.000 0.000 0.000" << std::endl;
-				leaves_material_file << "d 1.000" << std::endl;
-				leaves_material_file << "illum 2" << std::endl;
-			}
+	glBindVertexArray(state->triangle_vao);
 
-			leaves_material_file.close();
-		}
+	if (!quadtree->grid_vbo) {
+		const u32 grid_vertices_length = QUADTREE_GRID_TILES + 1;
 
-		leaves_file.close();
-	}
+		std::vector<V2> grid(grid_vertices_length * grid_vertices_length);
+		for (u32 i = 0; i < grid.size(); i++) {
+			grid[i] = { (real32)(i % grid_vertices_length), (real32)(i / grid_vertices_length) };
+		}
 
-	if (state->export_settings.rocks) {
-		std::ofstream rocks_file(path + "rocks.obj", std::ios::out);
-
-		if (rocks_file.good()) {
-			rocks_file << "mtllib rocks.mtl" << std::endl;
-			rocks_file << "usemtl colour" << std::endl;
-
-			u32 i = 0;
-			u32 vertex_offset = 0;
-			for (auto &p : state->rocks_pos) {
-				rocks_file << "o Tree_" << i++ << std::endl;
-				for (auto &v : state->rock->vertices) {
-					V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
-					V4 d = {};
-					real32 m[16];
-					mat4_identity(m);
-
-					real32 scale = state->cur_preset.params.rock_size * state->cur_preset.params.scale;
-					mat4_scale(m, scale, scale, scale);
-					mat4_rotate_z(m, state->rocks_rotation[i].z);
-					mat4_rotate_y(m, state->rocks_rotation[i].y);
-					mat4_rotate_x(m, state->rocks_rotation[i].x);
-				
-					for (u32 i = 0; i < 4; i++) {
-						for (u32 j = 0; j < 4; j++) {
-							d.E[i] += (m[i * 4 + j] * v4.E[j]);
-						}
-					}
+		glGenBuffers(1, &quadtree->grid_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, quadtree->grid_vbo);
+		glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(V2), grid.data(), GL_STATIC_DRAW);
 
-					const real32 x = d.x + p.x;
-					const real32 y = d.y + p.y;
-					const real32 z = d.z + p.z;
-					rocks_file << "v " << x << " " << " " << y << " " << z << std::endl;
-				}
+		glGenBuffers(1, &quadtree->grid_ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadtree->grid_ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, quadtree->grid_indices.size() * sizeof(u16), quadtree->grid_indices.data(), GL_STATIC_DRAW);
+	}
 
-				for (auto &v : state->rock->vertices) {
-					const real32 x = v->nor.x;
-					const real32 y = v->nor.y;
-					const real32 z = v->nor.z;
-					rocks_file << "vn " << x << " " << " " << y << " " << z << std::endl;
-				}
+	if (quadtree->height_texture) {
+		glDeleteTextures(1, &quadtree->height_texture);
+		glDeleteTextures(1, &quadtree->normal_texture);
+	}
 
-				for (auto f : state->rock->polygons) {
-					const u32 f0 = f->indices[0] + 1 + vertex_offset;
-					const u32 f1 = f->indices[1] + 1 + vertex_offset;
-					const u32 f2 = f->indices[2] + 1 + vertex_offset;
-					rocks_file << face_string_with_normals_and_uv(f0, f1, f2);
-				}
+	quadtree->height_texture = create_map_texture(GL_R32F, GL_RED, GL_FLOAT, quadtree->map_length, quadtree->heights.data());
+	quadtree->normal_texture = create_map_texture(GL_RG16_SNORM, GL_RG, GL_SHORT, quadtree->map_length, quadtree->normals.data());
+}
 
-				vertex_offset += state->rock->vertices.size();
-			}
+static void app_init_terrain(app_state *state)
+{
+	init_terrain(&state->world, state->cur_preset.params.chunk_tile_length, state->cur_preset.params.world_width);
 
-			std::ofstream rock_material_file(path + "rocks.mtl", std::ios::out);
+	for (u32 i = 0; i < state->world.chunks.size(); i++) {
+		if (!state->world.chunks[i]->vbo) {
+			glGenBuffers(1, &state->world.chunks[i]->vbo);
+		}
+	}
 
-			if (rock_material_file.good()) {
-				std::string colour_string = std::to_string(state->cur_preset.params.rock_colour.x) + " "
-					+ std::to_string(state->cur_preset.params.rock_colour.y) + " "
-					+ std::to_string(state->cur_preset.params.rock_colour.z);
+	upload_lod_indices(state);
+}
 
-				rock_material_file << "newmtl colour" << std::endl;
-				rock_material_file << "Ka " << colour_string << std::endl;
-				rock_material_file << "Kd " << colour_string << std::endl;
-				rock_material_file << "Ks 0.000 0.000 0.000" << std::endl;
-				rock_material_file << "d 1.000" << std::endl;
-				rock_material_file << "illum 2" << std::endl;
-			}
+static void generate_world(app_state *state)
+{
+	generate_terrain_chunks(&state->world);
 
-			rock_material_file.close();
-		}
+	glBindVertexArray(state->triangle_vao);
 
-		rocks_file.close();
-	}
+	for (u32 j = 0; j < state->cur_preset.params.world_width; j++) {
+		for (u32 i = 0; i < state->cur_preset.params.world_width; i++) {
+			u32 index = j * state->cur_preset.params.world_width + i;
 
-	// Material file.
-	std::ofstream material_file(path + "terrain.mtl", std::ios::out);
+			Chunk *chunk = state->world.chunks[index];
 
-	if (material_file.good()) {
-		material_file << "newmtl textured" << std::endl;
-		material_file << "Ka 1.000 1.000 1.000" << std::endl;
-		material_file << "Kd 1.000 1.000 1.000" << std::endl;
-		material_file << "Ks 1.000 1.000 1.000" << std::endl;
-		material_file << "d 1.000" << std::endl;
-		material_file << "illum 2" << std::endl;
+			glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+			glBufferData(GL_ARRAY_BUFFER, chunk->vertices_count * sizeof(ChunkVertex), chunk->vertices.data(), GL_STATIC_DRAW);
 
-		if (state->export_settings.texture_map) {
-			material_file << "map_Ka diffuse.tga" << std::endl;
-			material_file << "map_Kd diffuse.tga" << std::endl;
+			app_bind_chunk_buffers(state, chunk);
+			glEnableVertexAttribArray(0);
+			glEnableVertexAttribArray(1);
 		}
 	}
 
-	material_file.close();
+	if (state->use_quadtree) {
+		upload_quadtree(state);
+	}
 
-	// Texture map.
-	if (state->export_settings.texture_map) {
-		std::ofstream tga_file(path + "diffuse.tga", std::ios::binary);
-		if (!tga_file) return;
+	generate_trees(&state->world);
+	generate_rocks(&state->world);
+	state->feature_boxes_dirty = true;
+	state->shadow_map_dirty = true;
+}
 
-		char header[18] = { 0,0,2,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
-		header[12] = state->texture_map_data.resolution & 0xFF;
-		header[13] = (state->texture_map_data.resolution >> 8) & 0xFF;
-		header[14] = (state->texture_map_data.resolution) & 0xFF;
-		header[15] = (state->texture_map_data.resolution >> 8) & 0xFF;
-		header[16] = 24;
+static void export_terrain(app_state *state)
+{
+	const std::string path = export_create_directory("./export", state->cur_preset.name);
 
-		tga_file.write((char *)header, 18);
+	export_world(&state->world, &state->export_settings, state->trunk, state->leaves, state->rock, path);
 
+	// Texture map.
+	if (state->export_settings.texture_map) {
 		real32 no_clip[4] = { 0, -1, 0, 100000 };
 
 		real32 light_projection[16], light_view[16];
 		mat4_identity(light_projection);
 		mat4_identity(light_view);
-		mat4_ortho(light_projection, -1.f * state->world_tile_length, state->world_tile_length, -1.f * state->world_tile_length, state->world_tile_length, 1.f, 10000.f);
+		mat4_ortho(light_projection, -1.f * state->world.world_tile_length, state->world.world_tile_length, -1.f * state->world.world_tile_length, state->world.world_tile_length, 1.f, 10000.f);
 		mat4_look_at(light_view, state->light_pos, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
 
 		real32 light_space_matrix[16];
@@ -1168,36 +847,15 @@ static void export_terrain(app_state *state)
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
 		else {
-			// Render to frame buffer
-			glViewport(0, 0, 4096, 4096);
-			glBindFramebuffer(GL_FRAMEBUFFER, state->depth_map_fbo);
-			glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-
-			// Render the shadow map from the lights POV.
-			glUseProgram(state->depth_shader.program);
-			glUniformMatrix4fv(state->depth_shader.projection, 1, GL_FALSE, light_projection);
-			glUniformMatrix4fv(state->depth_shader.view, 1, GL_FALSE, light_view);
-
-			glCullFace(GL_FRONT);
-
-			for (u32 i = 0; i < state->chunk_count; i++) {
-				app_render_chunk(state, no_clip, state->chunks[i], state->depth_shader.model);
-			}
-
-			glCullFace(GL_BACK);
-
-			app_render_trunks(state, state->depth_shader.model);
-			app_render_leaves(state, state->depth_shader.model);
-			app_render_rocks(state, state->depth_shader.model);
-
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glViewport(0, 0, state->window_info.w, state->window_info.h);
+			// The same shadow map as on screen.
+			app_update_feature_boxes(state);
+			app_update_shadow_map(state, light_projection, light_view, light_space_matrix);
 
 			glBindTexture(GL_TEXTURE_2D, state->depth_map);
 		}
 
 		Camera copy_cam = state->cur_cam;
-		camera_ortho(&copy_cam, state->world_tile_length, state->world_tile_length);
+		camera_ortho(&copy_cam, state->world.world_tile_length, state->world.world_tile_length);
 		copy_cam.pos = { 0, 9000, 0 };
 		copy_cam.front = { 0, -1, 0 };
 		copy_cam.up = { 1, 0, 0 };
@@ -1206,6 +864,7 @@ static void export_terrain(app_state *state)
 		glUseProgram(state->terrain_shader.program);
 
 		glUniform4fv(state->terrain_shader.plane, 1, no_clip);
+		glUniform1i(state->terrain_shader.vertices_length, state->world.chunk_vertices_length);
 
 		glUniform1f(state->terrain_shader.ambient_strength, state->cur_preset.params.ambient_strength);
 		glUniform1f(state->terrain_shader.diffuse_strength, state->cur_preset.params.diffuse_strength);
@@ -1241,17 +900,19 @@ static void export_terrain(app_state *state)
 		for (u32 y = 0; y < state->cur_preset.params.world_width; y++) {
 			for (u32 x = 0; x < state->cur_preset.params.world_width; x++) {
 				u32 index = y * state->cur_preset.params.world_width + x;
-				glBindBuffer(GL_ARRAY_BUFFER, state->chunks[index]->vbo);
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->chunks[index]->ebo);
-				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-				glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
+				app_bind_chunk_buffers(state, state->world.chunks[index]);
 
 				real32 model[16];
 				mat4_identity(model);
 				mat4_translate(model, x * state->cur_preset.params.chunk_tile_length, 0, y * state->cur_preset.params.chunk_tile_length);
 				glUniformMatrix4fv(state->terrain_shader.model, 1, GL_FALSE, model);
 
-				glDrawElements(GL_TRIANGLES, state->chunks[index]->lod_data_infos[0].quads_count * 6, GL_UNSIGNED_INT, (void *)(0));
+				IndexRange ranges[LOD_DRAW_RANGES_COUNT];
+				lod_draw_ranges(&state->world.lod_settings, 0, 0, ranges);
+
+				for (const IndexRange &range : ranges) {
+					glDrawElements(GL_TRIANGLES, range.count, lod_index_type(&state->world.lod_settings), (void *)(range.offset * state->world.lod_settings.index_size));
+				}
 			}
 		}
 
@@ -1259,11 +920,9 @@ static void export_terrain(app_state *state)
 
 		glReadPixels(0, 0, state->texture_map_data.resolution, state->texture_map_data.resolution, GL_BGR, GL_UNSIGNED_BYTE, state->texture_map_data.pixels);
 
-		tga_file.write((char *)state->texture_map_data.pixels, state->texture_map_data.resolution * state->texture_map_data.resolution * sizeof(RGB));
-
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-		tga_file.close();
+		export_texture_map(path, state->texture_map_data.resolution, state->texture_map_data.pixels);
 	}
 }
 
@@ -1271,49 +930,45 @@ static void load_presets(app_state *state)
 {
 	for (auto &p : std::filesystem::directory_iterator("./presets/")) {
 		if (p.path().extension() == ".world") {
-			std::ifstream file(p.path(), std::ios::binary);
-
-			if (file.good()) {
-				preset_file p_file = {};
-				p_file.name = p.path().stem().string();
-				p_file.index = state->presets.size();
-				file.read((char *)&p_file.params, sizeof(world_generation_parameters));
+			preset_file p_file = {};
+			p_file.name = p.path().stem().string();
+			p_file.index = state->presets.size();
 
+			if (load_preset_file(p.path().string(), &p_file)) {
 				state->presets.push_back(new preset_file(p_file));
 			}
-
-			file.close();
 		}
 	}
 }
 
 static void save_custom_preset_to_file(preset_file *p_file)
 {
-	std::ofstream file("./presets/" + p_file->name + ".world", std::ios::binary);
-
-	if (file.good()) {
-		file.write((char *)&p_file->params, sizeof(world_generation_parameters));
-	}
-
-	file.close();
+	save_preset_file("./presets/" + p_file->name + ".world", p_file);
 }
 
-static void app_render(app_state *state)
+// The water plane over the whole world, visible when part of it is in the
+// camera's frustum and it isn't buried under the lowest terrain.
+static bool32 app_water_visible(app_state *state)
 {
-	real32 reflection_clip[4] = { 0, 1, 0, -state->cur_preset.params.water_pos.y };
-	real32 refraction_clip[4] = { 0, -1, 0, state->cur_preset.params.water_pos.y };
-	real32 no_clip[4] = { 0, -1, 0, 100000 };
+	const real32 water_height = state->cur_preset.params.water_pos.y;
 
-	real32 light_projection[16], light_view[16];
-	mat4_identity(light_projection);
-	mat4_identity(light_view);
-	mat4_ortho(light_projection, -1.f * state->world_tile_length, state->world_tile_length, -1.f * state->world_tile_length, state->world_tile_length, 1.f, 10000.f);
-	mat4_look_at(light_view, state->light_pos, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+	if (water_height < state->world.min_height) {
+		return false;
+	}
 
-	real32 light_space_matrix[16];
-	mat4_identity(light_space_matrix);
-	mat4_multiply(light_space_matrix, light_projection, light_view);
+	real32 view_projection[16];
+	mat4_multiply(view_projection, state->cur_cam.frustrum, state->cur_cam.view);
 
+	Frustum frustum;
+	frustum_from_matrix(&frustum, view_projection);
+
+	const real32 length = (real32)state->world.world_tile_length;
+	return frustum_test_box(&frustum, { 0.f, water_height, 0.f }, { length, water_height, length });
+}
+
+// Renders what the water reflects and refracts into its frame buffers.
+static void app_render_water_passes(app_state *state, real32 *reflection_clip, real32 *refraction_clip, real32 *light_space_matrix)
+{
 	Camera camera_backup = state->cur_cam;
 	Camera reflection_cam = state->cur_cam;
 	real32 distance = 2.f * (state->cur_cam.pos.y - state->cur_preset.params.water_pos.y);
@@ -1322,10 +977,6 @@ static void app_render(app_state *state)
 	camera_update(&reflection_cam);
 	camera_look_at(&reflection_cam);
 
-	glEnable(GL_CLIP_DISTANCE0);
-	
-	glClearColor(state->cur_preset.params.skybox_colour.E[0], state->cur_preset.params.skybox_colour.E[1], state->cur_preset.params.skybox_colour.E[2], 1.f);
-
 	// Reflection.
 	glBindFramebuffer(GL_FRAMEBUFFER, state->water_frame_buffers.reflection_fbo);
 	glViewport(0, 0, state->water_frame_buffers.REFLECTION_WIDTH, state->water_frame_buffers.REFLECTION_HEIGHT);
@@ -1333,24 +984,26 @@ static void app_render(app_state *state)
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	
 	state->cur_cam = reflection_cam;
+
+	real32 view_projection[16];
+	mat4_multiply(view_projection, state->cur_cam.frustrum, state->cur_cam.view);
+	app_begin_pass(state, RENDER_PASS_REFLECTION, view_projection, reflection_clip);
 	
-	terrain_shader_use(state, reflection_clip);
-	glUniformMatrix4fv(state->terrain_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
+	TerrainShader *terrain_shader = terrain_shader_use(state, reflection_clip);
+	glUniformMatrix4fv(terrain_shader->light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	
-	for (u32 i = 0; i < state->chunk_count; i++) {
-		app_render_chunk(state, reflection_clip, state->chunks[i], state->terrain_shader.model);
-	}
+	app_render_terrain(state, reflection_clip, terrain_shader->model, terrain_shader->node, terrain_shader->morph);
 	
 	simple_shader_use(state);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, state->depth_map);
 	glUniformMatrix4fv(state->simple_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.trunk_colour);
-	app_render_trunks(state, state->simple_shader.model);
+	app_render_trunks(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.leaves_colour);
-	app_render_leaves(state, state->simple_shader.model);
+	app_render_leaves(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.rock_colour);
-	app_render_rocks(state, state->simple_shader.model);
+	app_render_rocks(state, state->simple_shader.instance_scale);
 	
 	// Restore camera.
 	state->cur_cam = camera_backup;
@@ -1362,61 +1015,89 @@ static void app_render(app_state *state)
 	glViewport(0, 0, state->water_frame_buffers.REFRACTION_WIDTH, state->water_frame_buffers.REFRACTION_HEIGHT);
 	
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	mat4_multiply(view_projection, state->cur_cam.frustrum, state->cur_cam.view);
+	app_begin_pass(state, RENDER_PASS_REFRACTION, view_projection, refraction_clip);
 	
-	terrain_shader_use(state, refraction_clip);
-	glUniformMatrix4fv(state->terrain_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
+	terrain_shader = terrain_shader_use(state, refraction_clip);
+	glUniformMatrix4fv(terrain_shader->light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	
-	for (u32 i = 0; i < state->chunk_count; i++) {
-		app_render_chunk(state, refraction_clip, state->chunks[i], state->terrain_shader.model);
-	}
+	app_render_terrain(state, refraction_clip, terrain_shader->model, terrain_shader->node, terrain_shader->morph);
 	
 	simple_shader_use(state);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, state->depth_map); 
 	glUniformMatrix4fv(state->simple_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.trunk_colour);
-	app_render_trunks(state, state->simple_shader.model);
+	app_render_trunks(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.leaves_colour);
-	app_render_leaves(state, state->simple_shader.model);
+	app_render_leaves(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.rock_colour);
-	app_render_rocks(state, state->simple_shader.model);
+	app_render_rocks(state, state->simple_shader.instance_scale);
+}
 
-	// Render to frame buffer
-	glViewport(0, 0, 4096, 4096);
-	glBindFramebuffer(GL_FRAMEBUFFER, state->depth_map_fbo);
-	glClear(GL_DEPTH_BUFFER_BIT);
+static void app_render(app_state *state)
+{
+	// Before the reflection pass swaps the camera, so it uses the main
+	// camera's LODs too.
+	if (state->use_quadtree) {
+		const real32 pixels_per_unit = state->window_info.h / (2.f * tanf(radians(state->cur_cam.fov) / 2.f));
+		quadtree_update_ranges(&state->quadtree, pixels_per_unit, state->world.lod_settings.max_pixel_error);
+	} else {
+		app_update_chunk_lods(state);
+	}
 
-	// Render the shadow map from the lights POV.
-	glUseProgram(state->depth_shader.program);
-	glUniformMatrix4fv(state->depth_shader.projection, 1, GL_FALSE, light_projection);
-	glUniformMatrix4fv(state->depth_shader.view, 1, GL_FALSE, light_view);
-	
-	glCullFace(GL_FRONT);
+	app_update_feature_boxes(state);
 
-	for (u32 i = 0; i < state->chunk_count; i++) {
-		app_render_chunk(state, no_clip, state->chunks[i], state->depth_shader.model);
-	}
-	glCullFace(GL_BACK);
+	real32 reflection_clip[4] = { 0, 1, 0, -state->cur_preset.params.water_pos.y };
+	real32 refraction_clip[4] = { 0, -1, 0, state->cur_preset.params.water_pos.y };
+	real32 no_clip[4] = { 0, -1, 0, 100000 };
 
-	app_render_trunks(state, state->depth_shader.model);
-	app_render_leaves(state, state->depth_shader.model);
-	app_render_rocks(state, state->depth_shader.model);
+	real32 light_projection[16], light_view[16];
+	mat4_identity(light_projection);
+	mat4_identity(light_view);
+	mat4_ortho(light_projection, -1.f * state->world.world_tile_length, state->world.world_tile_length, -1.f * state->world.world_tile_length, state->world.world_tile_length, 1.f, 10000.f);
+	mat4_look_at(light_view, state->light_pos, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, state->window_info.w, state->window_info.h);
+	real32 light_space_matrix[16];
+	mat4_identity(light_space_matrix);
+	mat4_multiply(light_space_matrix, light_projection, light_view);
+
+	glEnable(GL_CLIP_DISTANCE0);
+	
+	glClearColor(state->cur_preset.params.skybox_colour.E[0], state->cur_preset.params.skybox_colour.E[1], state->cur_preset.params.skybox_colour.E[2], 1.f);
+
+	// First so the water passes also receive this frame's shadows. Culled to
+	// the light's ortho frustum rather than the camera's so offscreen casters
+	// still cast.
+	app_update_shadow_map(state, light_projection, light_view, light_space_matrix);
+
+	// Both water passes, and the quad, only when the water can be seen.
+	const bool32 water_visible = app_water_visible(state);
+
+	if (water_visible) {
+		app_render_water_passes(state, reflection_clip, refraction_clip, light_space_matrix);
+		state->water_frames_drawn++;
+	} else {
+		state->pass_stats[RENDER_PASS_REFLECTION] = {};
+		state->pass_stats[RENDER_PASS_REFRACTION] = {};
+		state->water_frames_skipped++;
+	}
 
 	// Finally render to screen.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	terrain_shader_use(state, no_clip);
-	glUniformMatrix4fv(state->terrain_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
+	real32 view_projection[16];
+	mat4_multiply(view_projection, state->cur_cam.frustrum, state->cur_cam.view);
+	app_begin_pass(state, RENDER_PASS_MAIN, view_projection, no_clip);
+
+	TerrainShader *terrain_shader = terrain_shader_use(state, no_clip);
+	glUniformMatrix4fv(terrain_shader->light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, state->depth_map);
 
-	for (u32 i = 0; i < state->chunk_count; i++) {
-		app_render_chunk(state, no_clip, state->chunks[i], state->terrain_shader.model);
-	}
+	app_render_terrain(state, no_clip, terrain_shader->model, terrain_shader->node, terrain_shader->morph);
 
 	simple_shader_use(state);
 
@@ -1425,43 +1106,45 @@ static void app_render(app_state *state)
 
 	glUniformMatrix4fv(state->simple_shader.light_space_matrix, 1, GL_FALSE, light_space_matrix);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.trunk_colour);
-	app_render_trunks(state, state->simple_shader.model);
+	app_render_trunks(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.leaves_colour);
-	app_render_leaves(state, state->simple_shader.model);
+	app_render_leaves(state, state->simple_shader.instance_scale);
 	glUniform3fv(state->simple_shader.object_colour, 1, (GLfloat *)&state->cur_preset.params.rock_colour);
-	app_render_rocks(state, state->simple_shader.model);
+	app_render_rocks(state, state->simple_shader.instance_scale);
 
 	glDisable(GL_CLIP_DISTANCE0);
 
 	// Water
-	glUseProgram(state->water_shader.program);
-	glBindVertexArray(state->triangle_vao);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, state->quad_vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->quad_ebo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
-	
-	real32 model[16];
-	mat4_identity(model);
-	mat4_translate(model, state->world_tile_length / 2, state->cur_preset.params.water_pos.y, state->world_tile_length / 2);
-	mat4_scale(model, state->world_tile_length, 1.f, state->world_tile_length);
-	
-	glUniformMatrix4fv(state->water_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
-	glUniformMatrix4fv(state->water_shader.view, 1, GL_FALSE, state->cur_cam.view);
-	glUniformMatrix4fv(state->water_shader.model, 1, GL_FALSE, model);
-	
-	glUniform3fv(state->water_shader.water_colour, 1, (GLfloat *)&state->cur_preset.params.water_colour);
-	
-	glUniform1i(state->water_shader.reflection_texture, 0);
-	glUniform1i(state->water_shader.refraction_texture, 1);
-	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, state->water_frame_buffers.reflection_texture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, state->water_frame_buffers.refraction_texture);
-	
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	if (water_visible) {
+		glUseProgram(state->water_shader.program);
+		glBindVertexArray(state->triangle_vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, state->quad_vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->quad_ebo);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof Vertex, (void *)(3 * sizeof(real32)));
+
+		real32 model[16];
+		mat4_identity(model);
+		mat4_translate(model, state->world.world_tile_length / 2, state->cur_preset.params.water_pos.y, state->world.world_tile_length / 2);
+		mat4_scale(model, state->world.world_tile_length, 1.f, state->world.world_tile_length);
+
+		glUniformMatrix4fv(state->water_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
+		glUniformMatrix4fv(state->water_shader.view, 1, GL_FALSE, state->cur_cam.view);
+		glUniformMatrix4fv(state->water_shader.model, 1, GL_FALSE, model);
+
+		glUniform3fv(state->water_shader.water_colour, 1, (GLfloat *)&state->cur_preset.params.water_colour);
+
+		glUniform1i(state->water_shader.reflection_texture, 0);
+		glUniform1i(state->water_shader.refraction_texture, 1);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, state->water_frame_buffers.reflection_texture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, state->water_frame_buffers.refraction_texture);
+
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	}
 	// End of water
 	
 	// UI	
@@ -1498,35 +1181,55 @@ static void app_render(app_state *state)
 			state->wireframe = !state->wireframe;
 		}
 
-		u32 quads_displayed = 0;
-		u32 quads_in_memory = 0;
-
-		for (u32 i = 0; i < state->chunk_count; i++) {
-			quads_in_memory += state->chunks[i]->lod_indices_count;
+		if (state->use_quadtree) {
+			// From the last pass, the main camera's.
+			ImGui::Text("Quadtree nodes drawn: %d of %d", (s32)state->quadtree_draws.size(), (s32)state->quadtree.nodes.size());
+		}
 
-			u32 lod_detail = 0;
+		// Indices -> Triangles, shared by every chunk.
+		const u32 triangles_in_memory = state->world.lod_settings.indices_count / 3;
 
-			if (state->chunks[i] != state->current_chunk) {
-				const u32 dx = state->chunks[i]->x - state->current_chunk->x;
-				const u32 dy = state->chunks[i]->y - state->current_chunk->y;
-				distance = sqrtf(dx * dx + dy * dy);
+		ImGui::Text("Triangles onscreen: %llu", (unsigned long long)state->pass_stats[RENDER_PASS_MAIN].triangles);
+		ImGui::Text("Triangles in memory: %d", triangles_in_memory);
+		ImGui::Text("Water passes: %llu frames drawn, %llu skipped", (unsigned long long)state->water_frames_drawn, (unsigned long long)state->water_frames_skipped);
+		ImGui::Text("Shadow map: %llu renders, %llu frames reused", (unsigned long long)state->shadow_map_renders, (unsigned long long)state->shadow_map_reuses);
 
-				// Cap the distance to the highest (lowest detail) LOD.
-				if (distance >= state->lod_settings.details_in_use) {
-					distance = state->lod_settings.details_in_use - 1;
-				}
+		if (ImGui::TreeNode("Culling")) {
+			const char *pass_names[RENDER_PASS_COUNT] = { "Reflection", "Refraction", "Shadow", "Main" };
 
-				lod_detail = distance;
+			for (u32 pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+				const RenderPassStats *stats = &state->pass_stats[pass];
+				ImGui::Text("%s: %d draws, %llu triangles", pass_names[pass], stats->draw_calls, (unsigned long long)stats->triangles);
+				ImGui::Text("  culled %d terrain, %d features, %llu triangles", stats->terrain_culled, stats->features_culled, (unsigned long long)stats->triangles_culled);
 			}
 
-			quads_displayed += state->chunks[i]->lod_data_infos[lod_detail].quads_count;
+			ImGui::TreePop();
 		}
 
-		// Indices -> Quads.
-		quads_in_memory /= 6;
+		if (ImGui::TreeNode("Memory")) {
+			WorldMemoryReport report;
+			world_memory_report(&state->world, &report);
+
+			const real32 mib = 1024.f * 1024.f;
+			ImGui::Text("Total: %.2f MiB", report.total / mib);
+			ImGui::Text("Terrain: %.2f MiB", report.terrain / mib);
+			ImGui::Text("Noise field: %.2f MiB", report.field / mib);
+			ImGui::Text("Features: %.2f MiB", report.features / mib);
+			ImGui::Text("Per chunk: %.1f KiB (vertices %.1f)", report.chunk_total / 1024.f, report.chunk_vertices / 1024.f);
+			ImGui::Text("LOD indices: %.1f KiB", report.lods / 1024.f);
 
-		ImGui::Text("Quads onscreen: %d", quads_displayed);
-		ImGui::Text("Quads in memory: %d", quads_in_memory);
+			if (state->use_quadtree) {
+				const u64 quadtree_maps = state->quadtree.heights.size() * sizeof(real32) + state->quadtree.normals.size() * sizeof(s16);
+				ImGui::Text("Quadtree maps: %.2f MiB, %d nodes", quadtree_maps / mib, (s32)state->quadtree.nodes.size());
+			}
+
+			for (u32 lod = 0; lod < state->world.lod_settings.max_available_count; lod++) {
+				const LODDataInfo *info = &state->world.lod_settings.data_infos[lod];
+				ImGui::Text("LOD %d: %.1f KiB, ACMR %.3f (row-major %.3f)", lod, report.lod_indices[lod] / 1024.f, info->acmr, info->acmr_unordered);
+			}
+
+			ImGui::TreePop();
+		}
 
 		ImGui::TreePop();
 	}
@@ -1717,9 +1420,15 @@ static void app_render(app_state *state)
 		ImGui::Separator();
 
 		if (ImGui::TreeNode("Level of detail")) {
-			ImGui::SliderInt("number of LODs", (int *)&state->lod_settings.details_in_use, 1, state->lod_settings.max_available_count, "%d", ImGuiSliderFlags_None);
+			ImGui::SliderInt("number of LODs", (int *)&state->world.lod_settings.details_in_use, 1, state->world.lod_settings.max_available_count, "%d", ImGuiSliderFlags_None);
 
-			regenerate_lods |= ImGui::SliderInt("LOD multiplier", (int *)&state->lod_settings.detail_multiplier, 1, state->lod_settings.max_detail_multiplier, "%d", ImGuiSliderFlags_None);
+			regenerate_lods |= ImGui::SliderInt("LOD multiplier", (int *)&state->world.lod_settings.detail_multiplier, 1, state->world.lod_settings.max_detail_multiplier, "%d", ImGuiSliderFlags_None);
+
+			ImGui::SliderFloat("max pixel error", &state->world.lod_settings.max_pixel_error, 0.f, 16.f, "%.1f", ImGuiSliderFlags_None);
+
+			if (ImGui::Checkbox("Quadtree (CDLOD)", &state->use_quadtree) && state->use_quadtree) {
+				upload_quadtree(state);
+			}
 
 			ImGui::TreePop();
 		}
@@ -1844,8 +1553,12 @@ static void app_render(app_state *state)
 		}
 
 		if (ImGui::TreeNode("Features")) {
+			// Typed in rather than slid, there's no upper limit.
+			const u32 feature_count_step = 1000, feature_count_step_fast = 100000;
+
 			if (ImGui::TreeNode("Trees")) {
-				regenerate_trees |= ImGui::SliderInt("tree count", (int *)&state->cur_preset.params.tree_count, 0, state->trees_pos.size() + 100, "%d", ImGuiSliderFlags_None);
+				regenerate_trees |= ImGui::InputScalar("tree count", ImGuiDataType_U32, &state->cur_preset.params.tree_count, &feature_count_step, &feature_count_step_fast, "%u", ImGuiInputTextFlags_EnterReturnsTrue);
+				ImGui::Text("%u placed", state->world.trees.count);
 				ImGui::SliderFloat("tree size", &state->cur_preset.params.tree_size, 0.1f, 5.f, "%.2f", ImGuiSliderFlags_None);
 				ImGui::SliderInt("tree min height", (int *)&state->cur_preset.params.tree_min_height, 0, 200, "%d", ImGuiSliderFlags_None);
 				ImGui::SliderInt("tree max height", (int *)&state->cur_preset.params.tree_max_height, 0, 200, "%d", ImGuiSliderFlags_None);
@@ -1855,7 +1568,8 @@ static void app_render(app_state *state)
 			}
 
 			if (ImGui::TreeNode("Rocks")) {
-				regenerate_rocks |= ImGui::SliderInt("rock count", (int *)&state->cur_preset.params.rock_count, 0, state->rocks_pos.size() + 100, "%d", ImGuiSliderFlags_None);
+				regenerate_rocks |= ImGui::InputScalar("rock count", ImGuiDataType_U32, &state->cur_preset.params.rock_count, &feature_count_step, &feature_count_step_fast, "%u", ImGuiInputTextFlags_EnterReturnsTrue);
+				ImGui::Text("%u placed", state->world.rocks.count);
 				ImGui::SliderFloat("rock size", &state->cur_preset.params.rock_size, 0.1f, 5.f, "%.2f", ImGuiSliderFlags_None);
 				ImGui::SliderInt("rock min height", (int *)&state->cur_preset.params.rock_min_height, 0, 200, "%d", ImGuiSliderFlags_None);
 				ImGui::SliderInt("rock max height", (int *)&state->cur_preset.params.rock_max_height, 0, 200, "%d", ImGuiSliderFlags_None);
@@ -1875,8 +1589,7 @@ static void app_render(app_state *state)
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 	if (reseed) {
-		state->rng.seed(state->cur_preset.params.seed);
-		seed_perlin(state->rng);
+		seed_perlin(&state->world.noise, state->cur_preset.params.seed);
 	}
 
 	if (regenerate_chunks || reinit_chunks) {
@@ -1885,23 +1598,29 @@ static void app_render(app_state *state)
 				state->cur_preset.params.world_width = 1;
 			}
 
-			init_terrain(state, state->cur_preset.params.chunk_tile_length, state->cur_preset.params.world_width);
+			app_init_terrain(state);
 		}
 
 		generate_world(state);
 	}
 
 	if (regenerate_lods) {
-		init_lod_detail_levels(&state->lod_settings, state->cur_preset.params.chunk_tile_length);
-		generate_world(state, true);
+		init_lod_detail_levels(&state->world.lod_settings, state->cur_preset.params.chunk_tile_length);
+		upload_lod_indices(state);
+		measure_lod_errors(&state->world);
+		state->shadow_map_dirty = true;
 	}
 
 	if (regenerate_trees) {
-		generate_trees(state);
+		generate_trees(&state->world);
+		state->feature_boxes_dirty = true;
+		state->shadow_map_dirty = true;
 	}
 
 	if (regenerate_rocks) {
-		generate_rocks(state);
+		generate_rocks(&state->world);
+		state->feature_boxes_dirty = true;
+		state->shadow_map_dirty = true;
 	}
 
 	if (update_camera) {
@@ -1910,66 +1629,44 @@ static void app_render(app_state *state)
 	// End of UI
 }
 
-static void init_terrain(app_state *state, u32 chunk_tile_length, u32 world_width)
+static void get_terrain_shader_uniforms(TerrainShader *shader)
 {
-	// ---Terrain data.
-	state->cur_preset.params.chunk_tile_length = chunk_tile_length;
-	state->chunk_vertices_length = state->cur_preset.params.chunk_tile_length + 1;
-	state->cur_preset.params.world_width = world_width;
-	state->world_area = state->cur_preset.params.world_width * state->cur_preset.params.world_width;
-	state->world_tile_length = state->cur_preset.params.chunk_tile_length * state->cur_preset.params.world_width;
-	// ---End of terrain data.
-
-	// ---LOD settings
-	// detail_multiplier = n where 2^n = the rate of detail loss for each LOD level.
-	// e.g detail multiplier = 2
-	// LOD 0: quality: 1 / (2 ^ 2) * 0
-	// LOD 1: quality: 1 / (2 ^ 2) * 1
-	// LOD 2: quality: 1 / (2 ^ 2) * 2
-	// ...
-	state->lod_settings.detail_multiplier = 1;
-	state->lod_settings.max_detail_multiplier = 1;
-
-	// Calculate the maximum possible detail multiplier for the chunk size.
-	while (pow(2, 5 + state->lod_settings.max_detail_multiplier) <= state->cur_preset.params.chunk_tile_length) {
-		state->lod_settings.max_detail_multiplier++;
-	}
-
-	state->lod_settings.max_details_count = 10;
-	state->lod_settings.details = (u32 *)malloc(state->lod_settings.max_details_count * sizeof(u32));
-
-	init_lod_detail_levels(&state->lod_settings, state->cur_preset.params.chunk_tile_length);
-	// ---end of LOD settings.
-
-	if (state->world_area > state->chunks.size()) {
-		u32 new_chunks = state->world_area - state->chunks.size();
-		while (new_chunks-- > 0) {
-			state->chunks.push_back(new Chunk);
-			glGenBuffers(1, &state->chunks.back()->vbo);
-			glGenBuffers(1, &state->chunks.back()->ebo);
-		}
-	}
-
-	state->chunk_count = 0;
-	for (u32 j = 0; j < state->cur_preset.params.world_width; j++) {
-		for (u32 i = 0; i < state->cur_preset.params.world_width; i++) {
-			u32 index = j * state->cur_preset.params.world_width + i;
-
-			u64 chunk_vertices_size = (u64)state->chunk_vertices_length * state->chunk_vertices_length * sizeof(Vertex);
-			u64 chunk_lods_size = (u64)state->lod_settings.max_available_count * state->cur_preset.params.chunk_tile_length * state->cur_preset.params.chunk_tile_length * sizeof(QuadIndices);
-			u32 vertices_count = state->chunk_vertices_length * state->chunk_vertices_length;
-
-			state->chunks[index]->vertices_count = vertices_count;
-			state->chunks[index]->lod_indices_count = 0;
-			state->chunks[index]->vertices.resize(chunk_vertices_size);
-			state->chunks[index]->lods.resize(chunk_lods_size);
-			state->chunks[index]->lod_data_infos.resize(state->lod_settings.max_available_count);
-			state->chunks[index]->x = i;
-			state->chunks[index]->y = j;
+	shader->projection = glGetUniformLocation(shader->program, "projection");
+	shader->view = glGetUniformLocation(shader->program, "view");
+	shader->model = glGetUniformLocation(shader->program, "model");
+	shader->light_space_matrix = glGetUniformLocation(shader->program, "light_space_matrix");
+	shader->shadow_map = glGetUniformLocation(shader->program, "shadow_map");
+	shader->light_pos = glGetUniformLocation(shader->program, "light_pos");
+	shader->plane = glGetUniformLocation(shader->program, "plane");
+	shader->vertices_length = glGetUniformLocation(shader->program, "vertices_length");
+	shader->sand_height = glGetUniformLocation(shader->program, "sand_height");
+	shader->stone_height = glGetUniformLocation(shader->program, "stone_height");
+	shader->snow_height = glGetUniformLocation(shader->program, "snow_height");
+	shader->light_colour = glGetUniformLocation(shader->program, "light_colour");
+	shader->ground_colour = glGetUniformLocation(shader->program, "ground_colour");
+	shader->slope_colour = glGetUniformLocation(shader->program, "slope_colour");
+	shader->sand_colour = glGetUniformLocation(shader->program, "sand_colour");
+	shader->stone_colour = glGetUniformLocation(shader->program, "stone_colour");
+	shader->snow_colour = glGetUniformLocation(shader->program, "snow_colour");
+	shader->ambient_strength = glGetUniformLocation(shader->program, "ambient_strength");
+	shader->diffuse_strength = glGetUniformLocation(shader->program, "diffuse_strength");
+	shader->specular_strength = glGetUniformLocation(shader->program, "specular_strength");
+	shader->gamma_correction = glGetUniformLocation(shader->program, "gamma_correction");
+	shader->view_position = glGetUniformLocation(shader->program, "view_position");
+
+	shader->node = glGetUniformLocation(shader->program, "node");
+	shader->morph = glGetUniformLocation(shader->program, "morph");
+	shader->world_length = glGetUniformLocation(shader->program, "world_length");
+	shader->height_map = glGetUniformLocation(shader->program, "height_map");
+	shader->normal_map = glGetUniformLocation(shader->program, "normal_map");
+}
 
-			state->chunk_count++;
-		}
-	}
+static void get_depth_shader_uniforms(DepthShader *shader)
+{
+	shader->projection = glGetUniformLocation(shader->program, "projection");
+	shader->view = glGetUniformLocation(shader->program, "view");
+	shader->model = glGetUniformLocation(shader->program, "model");
+	shader->vertices_length = glGetUniformLocation(shader->program, "vertices_length");
 }
 
 app_state *app_init(u32 w, u32 h)
@@ -2016,34 +1713,21 @@ app_state *app_init(u32 w, u32 h)
 	glEnableVertexAttribArray(1);
 	// ---End of quad mesh
 
+	// Filled per pass with the visible trees and rocks.
+	glGenBuffers(1, &state->tree_instance_vbo);
+	glGenBuffers(1, &state->rock_instance_vbo);
+
 	// ---Shaders
 	state->terrain_shader.program = create_shader(Shaders::DEFAULT_VERTEX_SHADER_SOURCE, Shaders::DEFAULT_FRAGMENT_SHADER_SOURCE);
-	state->terrain_shader.projection = glGetUniformLocation(state->terrain_shader.program, "projection");
-	state->terrain_shader.view = glGetUniformLocation(state->terrain_shader.program, "view");
-	state->terrain_shader.model = glGetUniformLocation(state->terrain_shader.program, "model");
-	state->terrain_shader.light_space_matrix = glGetUniformLocation(state->terrain_shader.program, "light_space_matrix");
-	state->terrain_shader.shadow_map = glGetUniformLocation(state->terrain_shader.program, "shadow_map");
-	state->terrain_shader.light_pos = glGetUniformLocation(state->terrain_shader.program, "light_pos");
-	state->terrain_shader.plane = glGetUniformLocation(state->terrain_shader.program, "plane");
-	state->terrain_shader.sand_height = glGetUniformLocation(state->terrain_shader.program, "sand_height");
-	state->terrain_shader.stone_height = glGetUniformLocation(state->terrain_shader.program, "stone_height");
-	state->terrain_shader.snow_height = glGetUniformLocation(state->terrain_shader.program, "snow_height");
-	state->terrain_shader.light_colour = glGetUniformLocation(state->terrain_shader.program, "light_colour");
-	state->terrain_shader.ground_colour = glGetUniformLocation(state->terrain_shader.program, "ground_colour");
-	state->terrain_shader.slope_colour = glGetUniformLocation(state->terrain_shader.program, "slope_colour");
-	state->terrain_shader.sand_colour = glGetUniformLocation(state->terrain_shader.program, "sand_colour");
-	state->terrain_shader.stone_colour = glGetUniformLocation(state->terrain_shader.program, "stone_colour");
-	state->terrain_shader.snow_colour = glGetUniformLocation(state->terrain_shader.program, "snow_colour");
-	state->terrain_shader.ambient_strength = glGetUniformLocation(state->terrain_shader.program, "ambient_strength");
-	state->terrain_shader.diffuse_strength = glGetUniformLocation(state->terrain_shader.program, "diffuse_strength");
-	state->terrain_shader.specular_strength = glGetUniformLocation(state->terrain_shader.program, "specular_strength");
-	state->terrain_shader.gamma_correction = glGetUniformLocation(state->terrain_shader.program, "gamma_correction");
-	state->terrain_shader.view_position = glGetUniformLocation(state->terrain_shader.program, "view_position");
+	get_terrain_shader_uniforms(&state->terrain_shader);
+
+	state->quadtree_shader.program = create_shader(Shaders::QUADTREE_VERTEX_SHADER_SOURCE, Shaders::DEFAULT_FRAGMENT_SHADER_SOURCE);
+	get_terrain_shader_uniforms(&state->quadtree_shader);
 
 	state->simple_shader.program = create_shader(Shaders::SIMPLE_VERTEX_SHADER_SOURCE, Shaders::SIMPLE_FRAGMENT_SHADER_SOURCE);
 	state->simple_shader.projection = glGetUniformLocation(state->simple_shader.program, "projection");
 	state->simple_shader.view = glGetUniformLocation(state->simple_shader.program, "view");
-	state->simple_shader.model = glGetUniformLocation(state->simple_shader.program, "model");
+	state->simple_shader.instance_scale = glGetUniformLocation(state->simple_shader.program, "instance_scale");
 	state->simple_shader.light_space_matrix = glGetUniformLocation(state->simple_shader.program, "light_space_matrix");
 	state->simple_shader.shadow_map = glGetUniformLocation(state->simple_shader.program, "shadow_map");
 	state->simple_shader.ambient_strength = glGetUniformLocation(state->simple_shader.program, "ambient_strength");
@@ -2064,7 +1748,11 @@ app_state *app_init(u32 w, u32 h)
 	state->depth_shader.program = create_shader(Shaders::DEPTH_VERTEX_SHADER_SOURCE, Shaders::DEPTH_FRAGMENT_SHADER_SOURCE);
 	state->depth_shader.projection = glGetUniformLocation(state->depth_shader.program, "projection");
 	state->depth_shader.view = glGetUniformLocation(state->depth_shader.program, "view");
-	state->depth_shader.model = glGetUniformLocation(state->depth_shader.program, "model");
+	state->depth_shader.instance_scale = glGetUniformLocation(state->depth_shader.program, "instance_scale");
+
+	state->terrain_depth_shader.program = create_shader(Shaders::TERRAIN_DEPTH_VERTEX_SHADER_SOURCE, Shaders::DEPTH_FRAGMENT_SHADER_SOURCE);
+	get_depth_shader_uniforms(&state->terrain_depth_shader);
+
 	// ---End of shaders
 
 	// --- Default generation parameters if no file is present.
@@ -2119,14 +1807,28 @@ app_state *app_init(u32 w, u32 h)
 	state->cur_preset = *state->presets[0];
 	// ---End of generation parameters
 
-	init_terrain(state, state->cur_preset.params.chunk_tile_length, state->cur_preset.params.world_width);
+	job_system_init(&state->jobs);
+
+	state->use_quadtree = false;
+	state->quadtree.grid_vbo = state->quadtree.grid_ebo = 0;
+	state->quadtree.height_texture = state->quadtree.normal_texture = 0;
+	state->world.lod_settings.ebo = 0;
+
+	state->water_frames_drawn = state->water_frames_skipped = 0;
+
+	state->shadow_map_key = {};
+	state->shadow_map_dirty = true;
+	state->shadow_map_renders = state->shadow_map_reuses = 0;
+
+	state->world.params = &state->cur_preset.params;
+	state->world.jobs = &state->jobs;
+
+	app_init_terrain(state);
 	init_water_data(state);
 	init_terrain_texture_maps(state);
 	init_depth_map(state);
 
-	state->rng = std::mt19937(state->cur_preset.params.seed);
-
-	seed_perlin(state->rng);
+	seed_perlin(&state->world.noise, state->cur_preset.params.seed);
 	generate_world(state);
 
 	camera_init(&state->cur_cam);
@@ -2210,28 +1912,23 @@ void app_update(app_state *state)
 	camera_look_at(&state->cur_cam);
 
 	// Keep track of current chunk for LODs and collision.
-	real32 contrained_x = min(state->world_tile_length - 1, max(0, state->cur_cam.pos.x));
-	real32 contrained_z = min(state->world_tile_length - 1, max(0, state->cur_cam.pos.z));
+	real32 contrained_x = min(state->world.world_tile_length - 1, max(0, state->cur_cam.pos.x));
+	real32 contrained_z = min(state->world.world_tile_length - 1, max(0, state->cur_cam.pos.z));
 
 	const u32 current_chunk_x = (u32)(contrained_x / state->cur_preset.params.chunk_tile_length);
 	const u32 current_chunk_z = (u32)(contrained_z / state->cur_preset.params.chunk_tile_length);
 
-	state->current_chunk = state->chunks[current_chunk_z * state->cur_preset.params.world_width + current_chunk_x];
+	state->current_chunk = state->world.chunks[current_chunk_z * state->cur_preset.params.world_width + current_chunk_x];
 
 	if (!state->cur_cam.flying) {
 		real32 cam_pos_x_relative = contrained_x - current_chunk_x * state->cur_preset.params.chunk_tile_length;
 		real32 cam_pos_z_relative = contrained_z - current_chunk_z * state->cur_preset.params.chunk_tile_length;
 
-		const u32 camera_vertex = (u32)cam_pos_z_relative * state->chunk_vertices_length + (u32)cam_pos_x_relative;
-		QuadIndices *camera_quad = &state->current_chunk->lod_data_infos[0].quads[0];
-
-		// Find the quad who's first vertex is the vertex bottom-left of the camera.
-		for (u32 quad_index = 0; quad_index < state->current_chunk->lod_data_infos[0].quads_count; quad_index++) {
-			if (state->current_chunk->lod_data_infos[0].quads[quad_index].i[2] == camera_vertex) {
-				camera_quad = &state->current_chunk->lod_data_infos[0].quads[quad_index];
-				break;
-			}
-		}
+		// The vertex bottom-left of the camera, kept inside the chunk's last tile.
+		const u32 last_tile = state->cur_preset.params.chunk_tile_length - 1;
+		const u32 camera_tile_x = (u32)cam_pos_x_relative < last_tile ? (u32)cam_pos_x_relative : last_tile;
+		const u32 camera_tile_z = (u32)cam_pos_z_relative < last_tile ? (u32)cam_pos_z_relative : last_tile;
+		const u32 camera_vertex = camera_tile_z * state->world.chunk_vertices_length + camera_tile_x;
 
 		// We now need to find which triangle the camera is in.
 		// To do this we can compare the distance from the left edge with the bottom edge.
@@ -2246,20 +1943,21 @@ void app_update(app_state *state)
 		i0 = camera_vertex;
 		
 		// p2 connects both triangles so we can set the vertex early.
-		i2 = camera_quad->i[0]; // Top right index.
+		i2 = camera_vertex + state->world.chunk_vertices_length + 1; // Top right index.
 
 		// Find which triangle the camera is on.
-		if (contrained_x - state->current_chunk->vertices[i0].pos.x > contrained_z - state->current_chunk->vertices[i0].pos.z) {
+		V3 p0 = chunk_vertex_position(&state->world, state->current_chunk, i0);
+
+		if (contrained_x - p0.x > contrained_z - p0.z) {
 			// bottom right triangle
-			i1 = camera_quad->i[1]; // bottom right index.
+			i1 = camera_vertex + 1; // bottom right index.
 		} else {
 			// top left triangle
-			i1 = camera_quad->i[3]; // top left index.
+			i1 = camera_vertex + state->world.chunk_vertices_length; // top left index.
 		}
 
-		V3 p0 = state->current_chunk->vertices[i0].pos;
-		V3 p1 = state->current_chunk->vertices[i1].pos;
-		V3 p2 = state->current_chunk->vertices[i2].pos;
+		V3 p1 = chunk_vertex_position(&state->world, state->current_chunk, i1);
+		V3 p2 = chunk_vertex_position(&state->world, state->current_chunk, i2);
 
 		// Plane equation found here from DanielKO's answer.
 		// https://stackoverflow.com/questions/18755251/linear-interpolation-of-three-3d-points-in-3d-space
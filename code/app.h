@@ -1,8 +1,6 @@
 #ifndef APP_H
 #define APP_H
 
-#include <thread>
-#include <random>
 #include <vector>
 #include <array>
 
@@ -10,6 +8,9 @@
 #include "maths.h"
 #include "camera.h"
 #include "object.h"
+#include "world.h"
+#include "export.h"
+#include "quadtree.h"
 
 #define Kilobytes(value) ((value) * 1024ULL)
 #define Megabytes(value) (Kilobytes(value) * 1024ULL)
@@ -55,53 +56,6 @@ struct app_window_info {
     bool32 resize, running;
 };
 
-struct world_generation_parameters {
-    real32 x_offset;
-    real32 z_offset;
-    real32 scale;
-    real32 lacunarity;
-    real32 persistence;
-    real32 elevation_power;
-    real32 y_scale;
-    real32 sand_height;
-    real32 stone_height;
-    real32 snow_height;
-    real32 ambient_strength;
-    real32 diffuse_strength;
-    real32 specular_strength;
-    real32 gamma_correction;
-    real32 rock_size;
-    real32 tree_size;
-    V3 water_pos;
-    V3 ground_colour;
-    V3 sand_colour;
-    V3 stone_colour;
-    V3 snow_colour;
-    V3 slope_colour;
-    V3 water_colour;
-    V3 light_colour;
-    V3 skybox_colour;
-    V3 rock_colour;
-    V3 trunk_colour;
-    V3 leaves_colour;
-    s32 max_octaves;
-    u32 chunk_tile_length;
-    u32 world_width;
-    u32 seed;
-    u32 tree_count;
-    u32 tree_min_height;
-    u32 tree_max_height;
-    u32 rock_count;
-    u32 rock_min_height;
-    u32 rock_max_height;
-};
-
-struct preset_file {
-    std::string name;
-    u32 index;
-    world_generation_parameters params;
-};
-
 struct TerrainShader {
     u32 program;
     u32 projection;
@@ -110,6 +64,7 @@ struct TerrainShader {
     u32 light_space_matrix;
     u32 shadow_map;
     u32 plane;
+    u32 vertices_length;
     u32 ambient_strength;
     u32 diffuse_strength;
     u32 specular_strength;
@@ -125,13 +80,20 @@ struct TerrainShader {
     u32 stone_height;
     u32 snow_height;
     u32 view_position;
+
+    // Quadtree only.
+    u32 node;
+    u32 morph;
+    u32 world_length;
+    u32 height_map;
+    u32 normal_map;
 };
 
 struct SimpleShader {
     u32 program;
     u32 projection;
     u32 view;
-    u32 model;
+    u32 instance_scale;
     u32 light_space_matrix;
     u32 shadow_map;
     u32 ambient_strength;
@@ -157,6 +119,8 @@ struct DepthShader {
     u32 projection;
     u32 view;
     u32 model;
+    u32 vertices_length;
+    u32 instance_scale; // Features only.
 };
 
 struct WaterFrameBuffers {
@@ -171,58 +135,44 @@ struct WaterFrameBuffers {
     u32 refraction_texture;
 };
 
-struct RGB {
-    u8 r, g, b;
-};
-
 struct TextureMapData {
     u32 resolution;
     u32 fbo, texture;
     RGB *pixels;
 };
 
-struct Vertex {
-    V3 pos;
-    V3 nor;
+enum RenderPass {
+    RENDER_PASS_REFLECTION,
+    RENDER_PASS_REFRACTION,
+    RENDER_PASS_SHADOW,
+    RENDER_PASS_MAIN,
+    RENDER_PASS_COUNT
 };
 
-struct QuadIndices {
-	u32 i[6];
-};
-
-struct LODDataInfo {
-    QuadIndices *quads;
-    u32 quads_count;
-    u64 data_offset;
-};
-
-struct Chunk {
-    std::vector<Vertex> vertices;
-    std::vector<QuadIndices> lods;
-    std::vector<LODDataInfo> lod_data_infos;
-    u64 lod_indices_count;
-    u64 vertices_count;
-    u32 x, y;
-    u32 vbo, ebo;
+// The inputs to the shadow map besides the terrain and feature placement,
+// which only change on regeneration.
+struct ShadowMapKey {
+    V3 light_pos;
+    real32 tree_scale, rock_scale;
+    u32 tree_min_height, tree_max_height;
+    u32 rock_min_height, rock_max_height;
 };
 
-struct ExportSettings {
-    bool32 with_normals;
-    bool32 texture_map;
-    bool32 bake_shadows;
-    bool32 lods;
-    bool32 seperate_chunks;
-    bool32 trees;
-    bool32 rocks;
+// A feature store's bounds for culling, each feature's and each chunk's
+// features together, for the size they were built at.
+struct FeatureBounds {
+    BoxSet boxes;
+    BoxSet chunk_boxes;
+    real32 scale;
 };
 
-struct LODSettings {
-    u32 *details;
-    u32 max_details_count; // Size of the array
-    u32 max_available_count; // Number of possible LODs for the chunk size.
-    u32 max_detail_multiplier; // The maximum multiplier to generate details.
-    u32 details_in_use; // Current amount of LODs being used.
-    u32 detail_multiplier;
+// What a pass drew and what its frustum culled, counted every frame.
+struct RenderPassStats {
+    u32 draw_calls;
+    u64 triangles;
+    u32 terrain_culled; // Chunks or quadtree nodes.
+    u32 features_culled; // Trees and rocks.
+    u64 triangles_culled;
 };
 
 struct app_state {
@@ -232,6 +182,8 @@ struct app_state {
     SimpleShader simple_shader;
     WaterShader water_shader;
     DepthShader depth_shader;
+    DepthShader terrain_depth_shader;
+    TerrainShader quadtree_shader;
 
     std::vector<preset_file*> presets;
     preset_file cur_preset;
@@ -248,18 +200,42 @@ struct app_state {
 
     WaterFrameBuffers water_frame_buffers;
 
-    std::vector<std::thread> generation_threads;
-    std::mt19937 rng;
-
-    LODSettings lod_settings;
-    std::vector<Chunk*> chunks;
+    JobSystem jobs;
+    World world;
     Chunk* current_chunk;
-    std::vector<V3> trees_pos, trees_rotation;
-    std::vector<V3> rocks_pos, rocks_rotation;
-    u32 chunk_count;
-    u32 chunk_vertices_length;
-    u32 world_area;
-    u32 world_tile_length;
+
+    // Draws the terrain as quadtree nodes instead of chunk by chunk.
+    TerrainQuadtree quadtree;
+    std::vector<QuadtreeDraw> quadtree_draws;
+    bool use_quadtree;
+
+    // Feature bounds for culling, rebuilt when the features are regenerated
+    // or resized.
+    FeatureBounds tree_bounds, rock_bounds;
+    bool32 feature_boxes_dirty;
+
+    // The pass being drawn, its frustum and which chunks and features are in it.
+    RenderPass cur_pass;
+    Frustum pass_frustum;
+    std::vector<u8> chunks_visible, feature_chunks_visible, features_visible;
+    RenderPassStats pass_stats[RENDER_PASS_COUNT];
+
+    // Each chunk's LOD, picked once a frame from the main camera and shared
+    // by every pass and by the neighbours stitching to it.
+    std::vector<u32> chunk_lods;
+
+    // The pass's visible tree and rock instances, uploaded by app_begin_pass.
+    u32 tree_instance_vbo, rock_instance_vbo;
+    u32 tree_instance_count, rock_instance_count;
+    std::vector<FeatureInstance> visible_instances;
+    u64 water_frames_drawn, water_frames_skipped;
+
+    // What the shadow map in depth_map was rendered with. shadow_map_dirty is
+    // set when the terrain or features are regenerated.
+    ShadowMapKey shadow_map_key;
+    bool32 shadow_map_dirty;
+    u64 shadow_map_renders, shadow_map_reuses;
+
     V3 light_pos;
     
     u32 triangle_vao, quad_vbo, quad_ebo;
@@ -1,6 +1,6 @@
 @echo off
 mkdir ..\build
 pushd ..\build
-cl ..\code\win32-terrain-generator.cpp ..\code\win32-opengl.cpp ..\code\maths.cpp ..\code\app.cpp ..\code\perlin.cpp ..\code\opengl-util.cpp ..\code\camera.cpp ..\code\imgui-master\*.cpp /MT /Zi user32.lib gdi32.lib opengl32.lib
+cl ..\code\win32-terrain-generator.cpp ..\code\win32-opengl.cpp ..\code\maths.cpp ..\code\app.cpp ..\code\world.cpp ..\code\vertex-cache.cpp ..\code\quadtree.cpp ..\code\frustum.cpp ..\code\jobs.cpp ..\code\export.cpp ..\code\object.cpp ..\code\perlin.cpp ..\code\random.cpp ..\code\opengl-util.cpp ..\code\camera.cpp ..\code\imgui-master\*.cpp /MT /Zi user32.lib gdi32.lib opengl32.lib
 popd
 
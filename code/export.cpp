@@ -0,0 +1,527 @@
+#include "export.h"
+
+#include <ctime>
+#include <iomanip>
+#include <fstream>
+#include <functional>
+#include <filesystem>
+#include <sstream>
+
+std::string export_create_directory(const std::string &root, const std::string &name)
+{
+	auto t = std::time(nullptr);
+	auto tm = *std::localtime(&t);
+	std::ostringstream oss;
+	oss << std::put_time(&tm, "%d-%m-%y-%H-%M-%S");
+
+	const std::string path = root + "/" + name + "-" + oss.str() + "/";
+
+	std::filesystem::create_directories(root); // If it somehow gets deleted.
+	std::filesystem::create_directory(path);
+
+	return path;
+}
+
+static std::string face_string_with_normals(u32 f0, u32 f1, u32 f2)
+{
+	std::stringstream ss;
+	ss << "f " << f0 << "//" << f0 << " " << f1 << "//" << f1 << " " << f2 << "//" << f2 << std::endl;
+	return ss.str();
+}
+
+static std::string face_string_with_uv(u32 f0, u32 f1, u32 f2)
+{
+	std::stringstream ss;
+	ss << "f " << f0 << "/" << f0 << " " << f1 << "/" << f1 << " " << f2 << "/" << f2 << std::endl;
+	return ss.str();
+}
+
+static std::string face_string_with_normals_and_uv(u32 f0, u32 f1, u32 f2)
+{
+	std::stringstream ss;
+	ss << "f " << f0 << "/" << f0 << "/" << f0 << " " << f1 << "/" << f1 << "/" << f1 << " " << f2 << "/" << f2 << "/" << f2 << std::endl;
+	return ss.str();
+}
+
+static std::string face_string_without_normals(u32 f0, u32 f1, u32 f2)
+{
+	std::stringstream ss;
+	ss << "f " << f0 << " " << f1 << " " << f2 << std::endl;
+	return ss.str();
+}
+
+void export_terrain_chunk(World *world, ExportSettings *settings, std::string path, Chunk *chunk)
+{
+	std::string filename = "chunk_" + std::to_string(chunk->y) + "_" + std::to_string(chunk->x) + ".obj";
+	std::ofstream object_file(path + filename, std::ios::out);
+
+	if (object_file.good()) {
+		object_file << "mtllib terrain.mtl" << std::endl;
+		object_file << "usemtl textured" << std::endl;
+		object_file << "o " << filename << std::endl;
+
+		for (u32 vertex = 0; vertex < chunk->vertices_count; vertex++) {
+			V3 pos = chunk_vertex_position(world, chunk, vertex);
+			// Offset chunk vertices by world position.
+			real32 x = pos.x + chunk->x * (world->params->chunk_tile_length);
+			real32 y = pos.y;
+			real32 z = pos.z + chunk->y * (world->params->chunk_tile_length);
+
+			object_file << "v " << x << " " << y << " " << z;
+			object_file << std::endl;
+		}
+
+		if (settings->texture_map) {
+			for (u32 vertex_row = 0; vertex_row < world->chunk_vertices_length; vertex_row++) {
+				for (u32 vertex_col = 0; vertex_col < world->chunk_vertices_length; vertex_col++) {
+					real32 u = (real32)(chunk->y * world->chunk_vertices_length + vertex_row) / (world->params->world_width * world->chunk_vertices_length);
+					real32 v = (real32)(chunk->x * world->chunk_vertices_length + vertex_col) / (world->params->world_width * world->chunk_vertices_length);
+
+					object_file << "vt " << u << " " << v << std::endl;
+				}
+			}
+		}
+
+		if (settings->with_normals) {
+			for (u32 vertex = 0; vertex < chunk->vertices_count; vertex++) {
+				V3 nor = chunk_vertex_normal(chunk, vertex);
+				real32 nx = nor.x;
+				real32 ny = nor.y;
+				real32 nz = nor.z;
+				object_file << "vn " << nx << " " << ny << " " << nz << std::endl;
+			}
+		}
+
+		std::function<std::string(u32, u32, u32)> face_string_func;
+		face_string_func = face_string_without_normals;
+
+		if (settings->with_normals) {
+			face_string_func = face_string_with_normals;
+
+			if (settings->texture_map) {
+				face_string_func = face_string_with_normals_and_uv;
+			}
+		}
+		else if (settings->texture_map) {
+			face_string_func = face_string_with_uv;
+		}
+
+		u32 num_lods_to_export = 1;
+
+		if (settings->lods) {
+			num_lods_to_export = world->lod_settings.details_in_use;
+		}
+
+		// Each LOD has a group in that object.
+		for (u32 lod_detail_index = 0; lod_detail_index < num_lods_to_export; lod_detail_index++) {
+			object_file << "g " << filename << "_lod" << lod_detail_index << std::endl;
+
+			const u32 lod_detail = world->lod_settings.details[lod_detail_index];
+
+			IndexRange ranges[LOD_DRAW_RANGES_COUNT];
+			lod_draw_ranges(&world->lod_settings, lod_detail_index, 0, ranges);
+
+			for (const IndexRange &range : ranges) {
+				for (u64 index = range.offset; index < range.offset + range.count; index += 3) {
+					u32 f0 = lod_index(&world->lod_settings, index) + 1;
+					u32 f1 = lod_index(&world->lod_settings, index + 1) + 1;
+					u32 f2 = lod_index(&world->lod_settings, index + 2) + 1;
+					object_file << face_string_func(f0, f1, f2);
+				}
+			}
+		}
+	}
+}
+
+void export_terrain_one_obj(World *world, ExportSettings *settings, std::string path)
+{
+	std::ofstream object_file(path + "terrain.obj", std::ios::out);
+
+	if (object_file.good()) {
+		object_file << "mtllib terrain.mtl" << std::endl;
+		object_file << "usemtl textured" << std::endl;
+		object_file << "o Terrain" << std::endl;
+
+		for (u32 chunk_z = 0; chunk_z < world->params->world_width; chunk_z++) {
+			for (u32 chunk_x = 0; chunk_x < world->params->world_width; chunk_x++) {
+				u32 chunk_index = chunk_z * world->params->world_width + chunk_x;
+
+				object_file << "# Chunk" << chunk_index << " vertices" << std::endl;
+
+				for (u32 vertex = 0; vertex < world->chunks[chunk_index]->vertices_count; vertex++) {
+					V3 pos = chunk_vertex_position(world, world->chunks[chunk_index], vertex);
+					// Offset chunk vertices by world position.
+					real32 x = pos.x + chunk_x * (world->params->chunk_tile_length);
+					real32 y = pos.y;
+					real32 z = pos.z + chunk_z * (world->params->chunk_tile_length);
+
+					object_file << "v " << x << " " << y << " " << z;
+					object_file << std::endl;
+				}
+			}
+		}
+
+		if (settings->texture_map) {
+			for (u32 chunk_z = 0; chunk_z < world->params->world_width; chunk_z++) {
+				for (u32 chunk_x = 0; chunk_x < world->params->world_width; chunk_x++) {
+					for (u32 vertex_row = 0; vertex_row < world->chunk_vertices_length; vertex_row++) {
+						for (u32 vertex_col = 0; vertex_col < world->chunk_vertices_length; vertex_col++) {
+							real32 u = (real32)(chunk_z * world->chunk_vertices_length + vertex_row) / (world->params->world_width * world->chunk_vertices_length);
+							real32 v = (real32)(chunk_x * world->chunk_vertices_length + vertex_col) / (world->params->world_width * world->chunk_vertices_length);
+
+							object_file << "vt " << u << " " << v << std::endl;
+						}
+					}
+				}
+			}
+		}
+
+		if (settings->with_normals) {
+			for (u32 chunk_z = 0; chunk_z < world->params->world_width; chunk_z++) {
+				for (u32 chunk_x = 0; chunk_x < world->params->world_width; chunk_x++) {
+					u32 chunk_index = chunk_z * world->params->world_width + chunk_x;
+
+					for (u32 vertex = 0; vertex < world->chunks[chunk_index]->vertices_count; vertex++) {
+						V3 nor = chunk_vertex_normal(world->chunks[chunk_index], vertex);
+						real32 nx = nor.x;
+						real32 ny = nor.y;
+						real32 nz = nor.z;
+						object_file << "vn " << nx << " " << ny << " " << nz << std::endl;
+					}
+				}
+			}
+		}
+
+		std::function<std::string(u32, u32, u32)> face_string_func;
+		face_string_func = face_string_without_normals;
+
+		if (settings->with_normals) {
+			face_string_func = face_string_with_normals;
+
+			if (settings->texture_map) {
+				face_string_func = face_string_with_normals_and_uv;
+			}
+		}
+		else if (settings->texture_map) {
+			face_string_func = face_string_with_uv;
+		}
+
+		for (u32 chunk_z = 0; chunk_z < world->params->world_width; chunk_z++) {
+			for (u32 chunk_x = 0; chunk_x < world->params->world_width; chunk_x++) {
+				u32 chunk_index = chunk_z * world->params->world_width + chunk_x;
+
+				u32 num_lods_to_export = 1;
+
+				if (settings->lods) {
+					num_lods_to_export = world->lod_settings.details_in_use;
+				}
+
+				// Each LOD has a group in that object.
+				for (u32 lod_detail_index = 0; lod_detail_index < num_lods_to_export; lod_detail_index++) {
+					object_file << "g Chunk" << chunk_index << "LOD" << lod_detail_index << std::endl;
+
+					const u32 lod_detail = world->lod_settings.details[lod_detail_index];
+
+					IndexRange ranges[LOD_DRAW_RANGES_COUNT];
+					lod_draw_ranges(&world->lod_settings, lod_detail_index, 0, ranges);
+
+					u64 chunk_vertices_number_offset = chunk_index * world->chunks[chunk_index]->vertices_count;
+
+					for (const IndexRange &range : ranges) {
+						for (u64 index = range.offset; index < range.offset + range.count; index += 3) {
+							u32 f0 = lod_index(&world->lod_settings, index) + 1 + chunk_vertices_number_offset;
+							u32 f1 = lod_index(&world->lod_settings, index + 1) + 1 + chunk_vertices_number_offset;
+							u32 f2 = lod_index(&world->lod_settings, index + 2) + 1 + chunk_vertices_number_offset;
+							object_file << face_string_func(f0, f1, f2);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	object_file.close();
+}
+
+void export_trees(World *world, Object *trunk, Object *leaves, std::string path)
+{
+	std::ofstream trunks_file(path + "tree_trunks.obj", std::ios::out);
+	
+	if (trunks_file.good()) {
+		trunks_file << "mtllib tree_trunks.mtl" << std::endl;
+		trunks_file << "usemtl colour" << std::endl;
+		
+		u32 vertex_offset = 0;
+		for (u32 i = 0; i < world->trees.count; i++) {
+			const V3 p = feature_position(&world->trees, i);
+			trunks_file << "o Tree_" << i << std::endl;
+			for (auto &v : trunk->vertices) {
+				V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
+				V4 d = {};
+				real32 m[16];
+				mat4_identity(m);
+
+				real32 scale = world->params->tree_size * world->params->scale;
+				mat4_scale(m, scale, scale, scale);
+				mat4_rotate_y(m, world->trees.rotation_y[i]);
+				
+				for (u32 i = 0; i < 4; i++) {
+					for (u32 j = 0; j < 4; j++) {
+						d.E[i] += (m[i * 4 + j] * v4.E[j]);
+					}
+				}
+
+				const real32 x = d.x + p.x;
+				const real32 y = d.y + p.y;
+				const real32 z = d.z + p.z;
+				trunks_file << "v " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto &v : trunk->vertices) {
+				const real32 x = v->nor.x;
+				const real32 y = v->nor.y;
+				const real32 z = v->nor.z;
+				trunks_file << "vn " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto f : trunk->polygons) {
+				const u32 f0 = f->indices[0] + 1 + vertex_offset;
+				const u32 f1 = f->indices[1] + 1 + vertex_offset;
+				const u32 f2 = f->indices[2] + 1 + vertex_offset;
+				trunks_file << face_string_with_normals_and_uv(f0, f1, f2);
+			}
+
+			vertex_offset += trunk->vertices.size();
+		}
+
+		std::ofstream trunk_material_file(path + "tree_trunks.mtl", std::ios::out);
+
+		if (trunk_material_file.good()) {
+			std::string colour_string = std::to_string(world->params->trunk_colour.x) + " "
+				+ std::to_string(world->params->trunk_colour.y) + " "
+				+ std::to_string(world->params->trunk_colour.z);
+
+			trunk_material_file << "newmtl colour" << std::endl;
+			trunk_material_file << "Ka " << colour_string << std::endl;
+			trunk_material_file << "Kd " << colour_string << std::endl;
+			trunk_material_file << "Ks 0.000 0.000 0.000" << std::endl;
+			trunk_material_file << "d 1.000" << std::endl;
+			trunk_material_file << "illum 2" << std::endl;
+		}
+
+		trunk_material_file.close();
+	}
+
+	trunks_file.close();
+
+	std::ofstream leaves_file(path + "tree_leaves.obj", std::ios::out);
+
+	if (leaves_file.good()) {
+		leaves_file << "mtllib tree_leaves.mtl" << std::endl;
+		leaves_file << "usemtl colour" << std::endl;
+
+		u32 vertex_offset = 0;
+		for (u32 i = 0; i < world->trees.count; i++) {
+			const V3 p = feature_position(&world->trees, i);
+			leaves_file << "o Leaves_" << i << std::endl;
+			for (auto &v : leaves->vertices) {
+				V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
+				V4 d = {};
+				real32 m[16];
+				mat4_identity(m);
+
+				real32 scale = world->params->tree_size * world->params->scale;
+				mat4_scale(m, scale, scale, scale);
+				mat4_rotate_y(m, world->trees.rotation_y[i]);
+
+				for (u32 i = 0; i < 4; i++) {
+					for (u32 j = 0; j < 4; j++) {
+						d.E[i] += (m[i * 4 + j] * v4.E[j]);
+					}
+				}
+
+				const real32 x = d.x + p.x;
+				const real32 y = d.y + p.y;
+				const real32 z = d.z + p.z;
+				leaves_file << "v " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto &v : leaves->vertices) {
+				const real32 x = v->nor.x;
+				const real32 y = v->nor.y;
+				const real32 z = v->nor.z;
+				leaves_file << "vn " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto f : leaves->polygons) {
+				const u32 f0 = f->indices[0] + 1 + vertex_offset;
+				const u32 f1 = f->indices[1] + 1 + vertex_offset;
+				const u32 f2 = f->indices[2] + 1 + vertex_offset;
+				leaves_file << face_string_with_normals_and_uv(f0, f1, f2);
+			}
+
+			vertex_offset += leaves->vertices.size();
+		}
+
+		std::ofstream leaves_material_file(path + "tree_leaves.mtl", std::ios::out);
+
+		if (leaves_material_file.good()) {
+			std::string colour_string = std::to_string(world->params->leaves_colour.x) + " "
+				+ std::to_string(world->params->leaves_colour.y) + " "
+				+ std::to_string(world->params->leaves_colour.z);
+
+			leaves_material_file << "newmtl colour" << std::endl;
+			leaves_material_file << "Ka " << colour_string << std::endl;
+			leaves_material_file << "Kd " << colour_string << std::endl;
+			leaves_material_file << "Ks 0.000 0.000 0.000" << std::endl;
+			leaves_material_file << "d 1.000" << std::endl;
+			leaves_material_file << "illum 2" << std::endl;
+		}
+
+		leaves_material_file.close();
+	}
+
+	leaves_file.close();
+}
+
+void export_rocks(World *world, Object *rock, std::string path)
+{
+	std::ofstream rocks_file(path + "rocks.obj", std::ios::out);
+
+	if (rocks_file.good()) {
+		rocks_file << "mtllib rocks.mtl" << std::endl;
+		rocks_file << "usemtl colour" << std::endl;
+
+		u32 vertex_offset = 0;
+		for (u32 i = 0; i < world->rocks.count; i++) {
+			const V3 p = feature_position(&world->rocks, i);
+			rocks_file << "o Tree_" << i << std::endl;
+			for (auto &v : rock->vertices) {
+				V4 v4 = { v->pos.x, v->pos.y, v->pos.z, 1.f };
+				V4 d = {};
+				real32 m[16];
+				mat4_identity(m);
+
+				real32 scale = world->params->rock_size * world->params->scale;
+				mat4_scale(m, scale, scale, scale);
+				mat4_rotate_z(m, world->rocks.rotation_z[i]);
+				mat4_rotate_y(m, world->rocks.rotation_y[i]);
+				mat4_rotate_x(m, world->rocks.rotation_x[i]);
+			
+				for (u32 i = 0; i < 4; i++) {
+					for (u32 j = 0; j < 4; j++) {
+						d.E[i] += (m[i * 4 + j] * v4.E[j]);
+					}
+				}
+
+				const real32 x = d.x + p.x;
+				const real32 y = d.y + p.y;
+				const real32 z = d.z + p.z;
+				rocks_file << "v " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto &v : rock->vertices) {
+				const real32 x = v->nor.x;
+				const real32 y = v->nor.y;
+				const real32 z = v->nor.z;
+				rocks_file << "vn " << x << " " << " " << y << " " << z << std::endl;
+			}
+
+			for (auto f : rock->polygons) {
+				const u32 f0 = f->indices[0] + 1 + vertex_offset;
+				const u32 f1 = f->indices[1] + 1 + vertex_offset;
+				const u32 f2 = f->indices[2] + 1 + vertex_offset;
+				rocks_file << face_string_with_normals_and_uv(f0, f1, f2);
+			}
+
+			vertex_offset += rock->vertices.size();
+		}
+
+		std::ofstream rock_material_file(path + "rocks.mtl", std::ios::out);
+
+		if (rock_material_file.good()) {
+			std::string colour_string = std::to_string(world->params->rock_colour.x) + " "
+				+ std::to_string(world->params->rock_colour.y) + " "
+				+ std::to_string(world->params->rock_colour.z);
+
+			rock_material_file << "newmtl colour" << std::endl;
+			rock_material_file << "Ka " << colour_string << std::endl;
+			rock_material_file << "Kd " << colour_string << std::endl;
+			rock_material_file << "Ks 0.000 0.000 0.000" << std::endl;
+			rock_material_file << "d 1.000" << std::endl;
+			rock_material_file << "illum 2" << std::endl;
+		}
+
+		rock_material_file.close();
+	}
+
+	rocks_file.close();
+}
+
+void export_terrain_material(ExportSettings *settings, std::string path)
+{
+	std::ofstream material_file(path + "terrain.mtl", std::ios::out);
+
+	if (material_file.good()) {
+		material_file << "newmtl textured" << std::endl;
+		material_file << "Ka 1.000 1.000 1.000" << std::endl;
+		material_file << "Kd 1.000 1.000 1.000" << std::endl;
+		material_file << "Ks 1.000 1.000 1.000" << std::endl;
+		material_file << "d 1.000" << std::endl;
+		material_file << "illum 2" << std::endl;
+
+		if (settings->texture_map) {
+			material_file << "map_Ka diffuse.tga" << std::endl;
+			material_file << "map_Kd diffuse.tga" << std::endl;
+		}
+	}
+
+	material_file.close();
+}
+
+void export_terrain_chunks(World *world, ExportSettings *settings, std::string path)
+{
+	if (settings->seperate_chunks) {
+		job_parallel_for(world->jobs, world->world_area, [world, settings, &path](u32 index) {
+			export_terrain_chunk(world, settings, path, world->chunks[index]);
+		});
+	}
+	else {
+		export_terrain_one_obj(world, settings, path);
+	}
+}
+
+void export_texture_map(std::string path, u32 resolution, RGB *pixels)
+{
+	std::ofstream tga_file(path + "diffuse.tga", std::ios::binary);
+	if (!tga_file) return;
+
+	char header[18] = { 0,0,2,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
+	header[12] = resolution & 0xFF;
+	header[13] = (resolution >> 8) & 0xFF;
+	header[14] = (resolution) & 0xFF;
+	header[15] = (resolution >> 8) & 0xFF;
+	header[16] = 24;
+
+	tga_file.write((char *)header, 18);
+	tga_file.write((char *)pixels, resolution * resolution * sizeof(RGB));
+
+	tga_file.close();
+}
+
+void export_world(World *world, ExportSettings *settings, Object *trunk, Object *leaves, Object *rock, std::string path)
+{
+	export_terrain_chunks(world, settings, path);
+
+	// Export trees & rocks.
+	if (settings->trees) {
+		export_trees(world, trunk, leaves, path);
+	}
+
+	if (settings->rocks) {
+		export_rocks(world, rock, path);
+	}
+
+	// Material file.
+	export_terrain_material(settings, path);
+}
@@ -0,0 +1,40 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <string>
+
+#include "types.h"
+#include "world.h"
+#include "object.h"
+
+struct ExportSettings {
+    bool32 with_normals;
+    bool32 texture_map;
+    bool32 bake_shadows;
+    bool32 lods;
+    bool32 seperate_chunks;
+    bool32 trees;
+    bool32 rocks;
+};
+
+struct RGB {
+    u8 r, g, b;
+};
+
+// Creates <root>/<name>-<timestamp>/ and returns it with a trailing slash.
+extern std::string export_create_directory(const std::string &root, const std::string &name);
+
+extern void export_terrain_chunk(World *world, ExportSettings *settings, std::string path, Chunk *chunk);
+extern void export_terrain_one_obj(World *world, ExportSettings *settings, std::string path);
+extern void export_terrain_chunks(World *world, ExportSettings *settings, std::string path);
+extern void export_trees(World *world, Object *trunk, Object *leaves, std::string path);
+extern void export_rocks(World *world, Object *rock, std::string path);
+extern void export_terrain_material(ExportSettings *settings, std::string path);
+
+// Writes a resolution x resolution 24 bit BGR image as path/diffuse.tga.
+extern void export_texture_map(std::string path, u32 resolution, RGB *pixels);
+
+// Everything except the texture map, which has to be rendered by the caller.
+extern void export_world(World *world, ExportSettings *settings, Object *trunk, Object *leaves, Object *rock, std::string path);
+
+#endif
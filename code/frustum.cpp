@@ -0,0 +1,121 @@
+#include "frustum.h"
+
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+void frustum_from_matrix(Frustum *frustum, const real32 *view_projection)
+{
+	// The fourth row plus or minus each of the others, taken from the column
+	// major matrix.
+	for (u32 i = 0; i < 6; i++) {
+		const u32 row = i / 2;
+		const real32 sign = (i & 1) ? -1.f : 1.f;
+
+		for (u32 column = 0; column < 4; column++) {
+			frustum->planes[i].E[column] = view_projection[3 + column * 4] + sign * view_projection[row + column * 4];
+		}
+	}
+
+	frustum->plane_count = 6;
+}
+
+void frustum_add_plane(Frustum *frustum, V4 plane)
+{
+	assert(frustum->plane_count < sizeof(frustum->planes) / sizeof(frustum->planes[0]));
+
+	frustum->planes[frustum->plane_count++] = plane;
+}
+
+bool32 frustum_test_box(const Frustum *frustum, V3 min, V3 max)
+{
+	// Outside if the corner furthest along any plane's normal is behind it.
+	for (u32 i = 0; i < frustum->plane_count; i++) {
+		const V4 &plane = frustum->planes[i];
+		const real32 x = plane.x > 0 ? max.x : min.x;
+		const real32 y = plane.y > 0 ? max.y : min.y;
+		const real32 z = plane.z > 0 ? max.z : min.z;
+
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void box_set_resize(BoxSet *boxes, u32 count)
+{
+	const u32 padded = count + 3;
+
+	boxes->min_x.assign(padded, 0.f);
+	boxes->min_y.assign(padded, 0.f);
+	boxes->min_z.assign(padded, 0.f);
+	boxes->max_x.assign(padded, 0.f);
+	boxes->max_y.assign(padded, 0.f);
+	boxes->max_z.assign(padded, 0.f);
+	boxes->count = count;
+}
+
+void box_set_store(BoxSet *boxes, u32 index, V3 min, V3 max)
+{
+	boxes->min_x[index] = min.x;
+	boxes->min_y[index] = min.y;
+	boxes->min_z[index] = min.z;
+	boxes->max_x[index] = max.x;
+	boxes->max_y[index] = max.y;
+	boxes->max_z[index] = max.z;
+}
+
+u32 frustum_cull_boxes(const Frustum *frustum, const BoxSet *boxes, u8 *visible)
+{
+	return frustum_cull_box_range(frustum, boxes, 0, boxes->count, visible);
+}
+
+u32 frustum_cull_box_range(const Frustum *frustum, const BoxSet *boxes, u32 first, u32 count, u8 *visible)
+{
+	const u32 end = first + count;
+	u32 visible_count = 0;
+	u32 i = first;
+
+#ifdef FRUSTUM_SSE
+	// Picking the furthest corner per plane is a select on the sign of each
+	// normal component, the same for all four boxes.
+	for (; i < end; i += 4) {
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (u32 p = 0; p < frustum->plane_count; p++) {
+			const V4 &plane = frustum->planes[p];
+			const __m128 x = _mm_loadu_ps(plane.x > 0 ? &boxes->max_x[i] : &boxes->min_x[i]);
+			const __m128 y = _mm_loadu_ps(plane.y > 0 ? &boxes->max_y[i] : &boxes->min_y[i]);
+			const __m128 z = _mm_loadu_ps(plane.z > 0 ? &boxes->max_z[i] : &boxes->min_z[i]);
+
+			__m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+
+		const s32 mask = _mm_movemask_ps(inside);
+
+		// Boxes past the end are never reported.
+		for (u32 lane = 0; lane < 4 && i + lane < end; lane++) {
+			visible[i + lane] = (mask >> lane) & 1;
+			visible_count += visible[i + lane];
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		const V3 min = { boxes->min_x[i], boxes->min_y[i], boxes->min_z[i] };
+		const V3 max = { boxes->max_x[i], boxes->max_y[i], boxes->max_z[i] };
+
+		visible[i] = frustum_test_box(frustum, min, max) ? 1 : 0;
+		visible_count += visible[i];
+	}
+
+	return visible_count;
+}
@@ -0,0 +1,46 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+
+#include "types.h"
+#include "maths.h"
+
+// Left, right, bottom, top, near and far, facing inwards, then any extra
+// planes such as a pass's clip plane. Not normalised so they only give which
+// side a point is on.
+struct Frustum {
+    V4 planes[8];
+    u32 plane_count;
+};
+
+// Axis aligned boxes with each coordinate in its own array so the planes can
+// be tested against four boxes at once. The arrays are padded with three
+// more so four can be loaded from any index.
+struct BoxSet {
+    std::vector<real32> min_x, min_y, min_z;
+    std::vector<real32> max_x, max_y, max_z;
+    u32 count;
+};
+
+// The planes of a perspective or orthographic projection times view.
+extern void frustum_from_matrix(Frustum *frustum, const real32 *view_projection);
+
+// Also cuts away what's behind plane, the same form as the shaders' clip
+// plane, x * a + y * b + z * c + d >= 0 is kept.
+extern void frustum_add_plane(Frustum *frustum, V4 plane);
+
+// True if any part of the box is inside, boxes straddling a plane count.
+extern bool32 frustum_test_box(const Frustum *frustum, V3 min, V3 max);
+
+extern void box_set_resize(BoxSet *boxes, u32 count);
+extern void box_set_store(BoxSet *boxes, u32 index, V3 min, V3 max);
+
+// Tests every box, visible gets 1 for each box at least partly inside and 0
+// otherwise. Returns how many are visible.
+extern u32 frustum_cull_boxes(const Frustum *frustum, const BoxSet *boxes, u8 *visible);
+
+// The same for count boxes from first, filling the same entries of visible.
+extern u32 frustum_cull_box_range(const Frustum *frustum, const BoxSet *boxes, u32 first, u32 count, u8 *visible);
+
+#endif
@@ -0,0 +1,159 @@
+#include "jobs.h"
+
+// Index of the queue owned by the current thread, -1 outside the pool.
+static thread_local s32 current_worker = -1;
+
+static bool32 job_pop(JobSystem *jobs, JobQueue *queue, Job *job, bool32 steal)
+{
+	std::lock_guard<std::mutex> lock(queue->mutex);
+
+	if (queue->jobs.empty()) {
+		return false;
+	}
+
+	if (steal) {
+		*job = queue->jobs.front();
+		queue->jobs.pop_front();
+	} else {
+		*job = queue->jobs.back();
+		queue->jobs.pop_back();
+	}
+
+	jobs->pending--;
+
+	return true;
+}
+
+static bool32 job_find(JobSystem *jobs, u32 home, Job *job)
+{
+	if (job_pop(jobs, &jobs->queues[home], job, false)) {
+		return true;
+	}
+
+	for (u32 i = 1; i < jobs->queue_count; i++) {
+		if (job_pop(jobs, &jobs->queues[(home + i) % jobs->queue_count], job, true)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void job_run(JobSystem *jobs, Job *job)
+{
+	(*job->func)(job->index);
+
+	// The counter lives on the waiting thread's stack, nothing can touch the
+	// job after this.
+	if (--job->counter->remaining == 0) {
+		// Taking the lock means the waiter is either still before its check
+		// or already asleep, so it can't miss this.
+		std::lock_guard<std::mutex> lock(jobs->sleep_mutex);
+		jobs->wake.notify_all();
+	}
+}
+
+static void job_worker(JobSystem *jobs, u32 index)
+{
+	current_worker = index;
+
+	while (jobs->running) {
+		Job job;
+
+		if (job_find(jobs, index, &job)) {
+			job_run(jobs, &job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(jobs->sleep_mutex);
+		jobs->wake.wait(lock, [jobs] { return jobs->pending > 0 || !jobs->running; });
+	}
+}
+
+void job_system_init(JobSystem *jobs, u32 worker_count)
+{
+	if (worker_count == JOB_WORKERS_AUTO) {
+		const u32 cores = std::thread::hardware_concurrency();
+		worker_count = cores > 1 ? cores - 1 : 0;
+	}
+
+	jobs->queue_count = worker_count + 1;
+	jobs->queues = new JobQueue[jobs->queue_count];
+	jobs->pending = 0;
+	jobs->running = true;
+
+	for (u32 i = 0; i < worker_count; i++) {
+		jobs->workers.push_back(std::thread(job_worker, jobs, i));
+	}
+}
+
+void job_system_shutdown(JobSystem *jobs)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleep_mutex);
+		jobs->running = false;
+	}
+
+	jobs->wake.notify_all();
+
+	for (auto &worker : jobs->workers) {
+		worker.join();
+	}
+
+	jobs->workers.clear();
+
+	delete[] jobs->queues;
+	jobs->queues = 0;
+	jobs->queue_count = 0;
+}
+
+u32 job_system_thread_count(JobSystem *jobs)
+{
+	return jobs ? jobs->workers.size() + 1 : 1;
+}
+
+void job_parallel_for(JobSystem *jobs, u32 count, const std::function<void(u32)> &func)
+{
+	if (!jobs || jobs->workers.empty() || count <= 1) {
+		for (u32 i = 0; i < count; i++) {
+			func(i);
+		}
+
+		return;
+	}
+
+	JobCounter counter;
+	counter.remaining = count;
+
+	// Threads outside the pool share the last queue.
+	const u32 home = current_worker >= 0 ? current_worker : jobs->queue_count - 1;
+
+	{
+		std::lock_guard<std::mutex> lock(jobs->queues[home].mutex);
+
+		for (u32 i = 0; i < count; i++) {
+			jobs->queues[home].jobs.push_back({ &func, i, &counter });
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleep_mutex);
+		jobs->pending += count;
+	}
+
+	jobs->wake.notify_all();
+
+	// Help out rather than block so nested parallel_for calls can't deadlock,
+	// and only sleep once there's nothing left to take.
+	while (counter.remaining > 0) {
+		Job job;
+
+		if (job_find(jobs, home, &job)) {
+			job_run(jobs, &job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(jobs->sleep_mutex);
+		jobs->wake.wait(lock, [jobs, &counter] { return counter.remaining == 0 || jobs->pending > 0; });
+	}
+}
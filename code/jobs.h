@@ -0,0 +1,62 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+struct JobCounter {
+    std::atomic<u32> remaining;
+};
+
+struct Job {
+    const std::function<void(u32)> *func;
+    u32 index;
+    JobCounter *counter;
+};
+
+// Each worker owns a deque, it pops its own work from the back and steals from
+// the front of the other deques when it runs dry.
+struct JobQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+// Persistent pool of worker threads. The thread waiting on a batch of jobs
+// helps run them, so there are hardware_concurrency - 1 workers and the
+// machine is never oversubscribed.
+struct JobSystem {
+    std::vector<std::thread> workers;
+    JobQueue *queues; // One per worker plus one for threads outside the pool.
+    u32 queue_count;
+
+    // Wakes sleeping workers when jobs are queued, and threads waiting on a
+    // batch when it finishes or there's something for them to help with.
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<s32> pending; // Jobs sitting in a queue.
+    std::atomic<bool> running;
+};
+
+// One worker per core, minus the calling thread.
+#define JOB_WORKERS_AUTO 0xFFFFFFFF
+
+// worker_count 0 starts no workers and every job runs inline on the thread
+// that waits for it.
+extern void job_system_init(JobSystem *jobs, u32 worker_count = JOB_WORKERS_AUTO);
+extern void job_system_shutdown(JobSystem *jobs);
+
+// Number of threads that run jobs, including the waiting thread.
+extern u32 job_system_thread_count(JobSystem *jobs);
+
+// Runs func(0) .. func(count - 1) across the pool and returns once they have
+// all finished. jobs may be null, in which case everything runs inline.
+extern void job_parallel_for(JobSystem *jobs, u32 count, const std::function<void(u32)> &func);
+
+#endif
@@ -123,6 +123,44 @@ V3 v3_normalise(V3 v)
 	};
 }
 
+// Octahedral encoding folded around y, the up axis, so upward facing normals
+// use most of the precision. Two snorm16 values, the same as GL_SHORT
+// normalised vertex attributes.
+void v3_oct_encode(V3 n, s16 *out)
+{
+	const real32 l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	real32 u = n.x / l1;
+	real32 v = n.z / l1;
+
+	if (n.y < 0) {
+		const real32 folded_u = (1.f - fabsf(v)) * (u >= 0 ? 1.f : -1.f);
+		const real32 folded_v = (1.f - fabsf(u)) * (v >= 0 ? 1.f : -1.f);
+		u = folded_u;
+		v = folded_v;
+	}
+
+	u = u < -1.f ? -1.f : (u > 1.f ? 1.f : u);
+	v = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+
+	out[0] = (s16)roundf(u * 32767.f);
+	out[1] = (s16)roundf(v * 32767.f);
+}
+
+V3 v3_oct_decode(const s16 *in)
+{
+	const real32 u = in[0] < -32767 ? -1.f : in[0] / 32767.f;
+	const real32 v = in[1] < -32767 ? -1.f : in[1] / 32767.f;
+
+	V3 n = { u, 1.f - fabsf(u) - fabsf(v), v };
+
+	if (n.y < 0) {
+		n.x = (1.f - fabsf(v)) * (u >= 0 ? 1.f : -1.f);
+		n.z = (1.f - fabsf(u)) * (v >= 0 ? 1.f : -1.f);
+	}
+
+	return v3_normalise(n);
+}
+
 real32 v3_dot(V3 a, V3 b)
 {
 	return a.x * b.x + a.y * b.y + a.z * b.z;
@@ -54,6 +54,8 @@ extern V3 v3_normalise(V3 v);
 extern real32 v3_dot(V3 a, V3 b);
 extern real32 v2_dot(V2 a, V2 b);
 extern V3 v3_cross(V3 a, V3 b);
+extern void v3_oct_encode(V3 n, s16 *out);
+extern V3 v3_oct_decode(const s16 *in);
 
 // Matrix functions.
 extern void mat4_copy(real32* dest, real32* src);
@@ -1,10 +1,10 @@
 #include <string>
 #include <fstream>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "win32-opengl.h"
 #include "object.h"
-#include "app.h"
 
 void add_vertex(Object *obj, std::string line) 
 {
@@ -112,49 +112,31 @@ Object *load_object(const char *filename)
     return obj;
 }
 
-void create_vbos(Object *obj)
+void free_object(Object *obj)
 {
-    s32 vertex_size = sizeof(real32) * obj->vertices.size() * 6;
-    real32 *vert_data = (real32*)malloc(vertex_size);
-
-    s32 polygon_size = sizeof(u32) * obj->polygons.size() * 3;
-    u32 *poly_data = (u32*)malloc(polygon_size);
+    if (!obj) {
+        return;
+    }
 
-    if (vert_data && poly_data) {
-        glGenBuffers(2, obj->vbos);
+    for (SpookyVertex *vertex : obj->vertices) {
+        free(vertex);
+    }
 
-        s32 offset = 0;
-        for (s32 i = 0; i < obj->vertices.size(); i++, offset += 6) {
-            memcpy(vert_data + offset, obj->vertices[i], 6 * sizeof(real32));
-        }
+    for (Poly *polygon : obj->polygons) {
+        free(polygon);
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, obj->vbos[0]);
-        glBufferData(GL_ARRAY_BUFFER, vertex_size, vert_data, GL_STATIC_DRAW);
+    delete obj;
+}
 
-        offset = 0;
-        for (s32 i = 0; i < obj->polygons.size(); i++, offset += 3) {
-            memcpy(poly_data + offset, obj->polygons[i]->indices, 3 * sizeof(u32));
-        }
+real32 object_radius(const Object *obj)
+{
+    real32 radius_squared = 0;
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->vbos[1]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, polygon_size, poly_data, GL_STATIC_DRAW);
+    for (const SpookyVertex *vertex : obj->vertices) {
+        const real32 length_squared = v3_dot(vertex->pos, vertex->pos);
+        radius_squared = length_squared > radius_squared ? length_squared : radius_squared;
     }
 
-    free(vert_data);
-    free(poly_data);
+    return sqrtf(radius_squared);
 }
-
-void draw_object(Object *obj, app_state *state, real32 *model)
-{
-	glBindBuffer(GL_ARRAY_BUFFER, obj->vbos[0]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(real32), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(real32), (void*)(3 * sizeof(real32)));
-	glEnableVertexAttribArray(1);
-
-	glUniformMatrix4fv(state->simple_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
-	glUniformMatrix4fv(state->simple_shader.view, 1, GL_FALSE, state->cur_cam.view);
-	glUniformMatrix4fv(state->simple_shader.model, 1, GL_FALSE, model);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->vbos[1]);
-	glDrawElements(GL_TRIANGLES, 3 * obj->polygons.size(), GL_UNSIGNED_INT, 0);
-}
\ No newline at end of file
@@ -2,12 +2,11 @@
 #define OBJECT_H
 
 #include <vector>
+#include <stdlib.h>
 
 #include "types.h"
 #include "maths.h"
 
-struct app_state;
-
 struct SpookyVertex {
     V3 pos;
     V3 nor;
@@ -24,8 +23,10 @@ struct Object {
 };
 
 extern Object *load_object(const char *filename);
-extern void create_vbos(Object *obj);
-extern void draw_object(Object *obj, app_state *state, float *model);
+// Frees an object from load_object, null is ignored.
+extern void free_object(Object *obj);
+// Furthest any vertex is from the object's origin, bounds it however it's rotated.
+extern real32 object_radius(const Object *obj);
 
 inline real32 atof_ex(const char *text) { return (real32)atof(text); }
 inline u32 atoi_ex(const char *text) { return (u32)(atoi(text) - 1); }
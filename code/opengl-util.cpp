@@ -2,8 +2,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "win32-opengl.h"
+#include "app.h"
 
 bool gl_check_shader_compile_log(u32 shader)
 {
@@ -46,4 +48,51 @@ u32 gl_compile_shader_from_source(const char *source, u32 program, s32 type)
     gl_check_shader_compile_log(shader);
 
     return shader;
+}
+
+void create_vbos(Object *obj)
+{
+    s32 vertex_size = sizeof(real32) * obj->vertices.size() * 6;
+    real32 *vert_data = (real32*)malloc(vertex_size);
+
+    s32 polygon_size = sizeof(u32) * obj->polygons.size() * 3;
+    u32 *poly_data = (u32*)malloc(polygon_size);
+
+    if (vert_data && poly_data) {
+        glGenBuffers(2, obj->vbos);
+
+        s32 offset = 0;
+        for (s32 i = 0; i < obj->vertices.size(); i++, offset += 6) {
+            memcpy(vert_data + offset, obj->vertices[i], 6 * sizeof(real32));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, obj->vbos[0]);
+        glBufferData(GL_ARRAY_BUFFER, vertex_size, vert_data, GL_STATIC_DRAW);
+
+        offset = 0;
+        for (s32 i = 0; i < obj->polygons.size(); i++, offset += 3) {
+            memcpy(poly_data + offset, obj->polygons[i]->indices, 3 * sizeof(u32));
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->vbos[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, polygon_size, poly_data, GL_STATIC_DRAW);
+    }
+
+    free(vert_data);
+    free(poly_data);
+}
+
+void draw_object(Object *obj, app_state *state, real32 *model)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, obj->vbos[0]);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(real32), (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(real32), (void*)(3 * sizeof(real32)));
+	glEnableVertexAttribArray(1);
+
+	glUniformMatrix4fv(state->simple_shader.projection, 1, GL_FALSE, state->cur_cam.frustrum);
+	glUniformMatrix4fv(state->simple_shader.view, 1, GL_FALSE, state->cur_cam.view);
+	glUniformMatrix4fv(state->simple_shader.model, 1, GL_FALSE, model);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->vbos[1]);
+	glDrawElements(GL_TRIANGLES, 3 * obj->polygons.size(), GL_UNSIGNED_INT, 0);
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 #define OPENGL_UTIL_H
 
 #include "types.h"
+#include "object.h"
+
+struct app_state;
 
 extern bool gl_check_shader_compile_log(u32 shader);
 extern bool gl_check_program_link_log(u32 program);
 extern u32 gl_compile_shader_from_source(const char *source, u32 program, s32 type);
 
+extern void create_vbos(Object *obj);
+extern void draw_object(Object *obj, app_state *state, float *model);
+
 #endif
\ No newline at end of file
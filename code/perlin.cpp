@@ -1,27 +1,43 @@
 #include "perlin.h"
 
-static u8 P[512];
+#include "random.h"
 
-#include <windows.h>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PERLIN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PERLIN_TARGET(isa)
+#else
+#define PERLIN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
 
-void seed_perlin(std::mt19937 &rng)
+void seed_perlin(NoiseContext *noise, u32 seed)
 {
-	std::uniform_int_distribution<> distr(0, 255);
+	RandomStream stream = random_stream(seed, RANDOM_NOISE, 0, 0);
 
     for (u32 i = 0; i < 256; i++) {
-        P[i] = i;
+        noise->P[i] = i;
     }
 
-    for (u32 i = 0; i < 256; i++) {
-        const u8 index = distr(rng);
-        const u8 temp = P[index];
-        P[i] = P[index];
-        P[index] = temp;
+    // Fisher-Yates, so every value appears once.
+    for (u32 i = 255; i > 0; i--) {
+        const u32 index = random_below(&stream, i + 1);
+        const u8 temp = noise->P[i];
+        noise->P[i] = noise->P[index];
+        noise->P[index] = temp;
     }
 
     for (u32 i = 256; i < 512; i++) {
-        P[i] = P[i - 256];
+        noise->P[i] = noise->P[i - 256];
     }
+
+	for (u32 i = 0; i < 512; i++) {
+		noise->P32[i] = noise->P[i];
+	}
+
+	noise->revision++;
 }
 
 // 6t5-15t4+10t3
@@ -47,13 +63,19 @@ real32 lerp(real32 t, real32 a, real32 b)
     return a + t * (b - a);
 }
 
-real32 perlin(V2 p)
+// d/dt of fade, 30t4-60t3+30t2
+static real32 fade_derivative(real32 t)
+{
+	return ((30 * t - 60) * t + 30) * t * t;
+}
+
+real32 perlin_gradient(const NoiseContext *noise, V2 p, V2 *gradient)
 {
     const real32 x = p.x;
     const real32 y = p.y;
 
-    const u32 X = (u32)floor(p.x) & 255;
-	const u32 Y = (u32)floor(p.y) & 255;
+    const u32 X = (s32)floor(p.x) & 255;
+	const u32 Y = (s32)floor(p.y) & 255;
 
 	const real32 xf = x - floor(x);
 	const real32 yf = y - floor(y);
@@ -64,21 +86,478 @@ real32 perlin(V2 p)
 	const V2 bottomLeft = { xf, yf };
 	
 	//Select a value in the array for each of the 4 corners
-	const real32 valueTopRight = P[P[X+1]+Y+1];
-	const real32 valueTopLeft = P[P[X]+Y+1];
-	const real32 valueBottomRight = P[P[X+1]+Y];
-	const real32 valueBottomLeft = P[P[X]+Y];
+	const V2 gradTopRight = get_vector(noise->P[noise->P[X+1]+Y+1]);
+	const V2 gradTopLeft = get_vector(noise->P[noise->P[X]+Y+1]);
+	const V2 gradBottomRight = get_vector(noise->P[noise->P[X+1]+Y]);
+	const V2 gradBottomLeft = get_vector(noise->P[noise->P[X]+Y]);
 	
-	const real32 dotTopRight = v2_dot(topRight, get_vector(valueTopRight));
-	const real32 dotTopLeft = v2_dot(topLeft, get_vector(valueTopLeft));
-	const real32 dotBottomRight = v2_dot(bottomRight, get_vector(valueBottomRight));
-	const real32 dotBottomLeft = v2_dot(bottomLeft, get_vector(valueBottomLeft));
+	const real32 dotTopRight = v2_dot(topRight, gradTopRight);
+	const real32 dotTopLeft = v2_dot(topLeft, gradTopLeft);
+	const real32 dotBottomRight = v2_dot(bottomRight, gradBottomRight);
+	const real32 dotBottomLeft = v2_dot(bottomLeft, gradBottomLeft);
 	
 	const real32 u = fade(xf);
 	const real32 v = fade(yf);
-	
-	return lerp(u,
-		lerp(v, dotBottomLeft, dotTopLeft),
-		lerp(v, dotBottomRight, dotTopRight)
-	);
-}
\ No newline at end of file
+
+	const real32 left = lerp(v, dotBottomLeft, dotTopLeft);
+	const real32 right = lerp(v, dotBottomRight, dotTopRight);
+
+	// Product rule through the lerps, each corner's dot product changes by
+	// its gradient vector as the point moves.
+	const real32 du = fade_derivative(xf);
+	const real32 dv = fade_derivative(yf);
+
+	const real32 left_dx = lerp(v, gradBottomLeft.x, gradTopLeft.x);
+	const real32 right_dx = lerp(v, gradBottomRight.x, gradTopRight.x);
+	const real32 left_dy = lerp(v, gradBottomLeft.y, gradTopLeft.y) + dv * (dotTopLeft - dotBottomLeft);
+	const real32 right_dy = lerp(v, gradBottomRight.y, gradTopRight.y) + dv * (dotTopRight - dotBottomRight);
+
+	gradient->x = lerp(u, left_dx, right_dx) + du * (right - left);
+	gradient->y = lerp(u, left_dy, right_dy);
+
+	return lerp(u, left, right);
+}
+
+real32 perlin(const NoiseContext *noise, V2 p)
+{
+	V2 gradient;
+	return perlin_gradient(noise, p, &gradient);
+}
+
+// ---Batched rows.
+// Every kernel evaluates exactly the same operations in the same order as
+// perlin_gradient() above, the gradient dot products are sign flips rather
+// than multiplies by +-1 which is also exact. With the default floating point
+// settings (no FMA contraction) the values and gradients are bit identical to
+// perlin_gradient(), i.e. 0 ULP. If the scalar path is built with contraction
+// enabled (/fp:fast, -ffast-math or -march with FMA) the fade and lerps fuse
+// and the values drift by up to 3e-6 absolute, under 32 ULP of 1.0, measured
+// over a few million samples.
+// Inputs are expected to satisfy |x| < 2^31.
+
+struct PerlinRowY {
+	s32 Y;
+	real32 yf;
+	real32 yf1;
+	real32 v;
+	real32 dv;
+};
+
+static PerlinRowY perlin_row_y(real32 y)
+{
+	PerlinRowY row;
+	row.Y = (s32)floor(y) & 255;
+	row.yf = y - floor(y);
+	row.yf1 = row.yf - 1.f;
+	row.v = fade(row.yf);
+	row.dv = fade_derivative(row.yf);
+	return row;
+}
+
+// Every kernel takes both y and its PerlinRowY. The scalar path is the
+// reference so it samples from y, the SIMD kernels use row and only pass y
+// on to the scalar path for their tails.
+static void perlin_row_scalar(const NoiseContext *noise, const real32 *xs, real32 y, const PerlinRowY *, real32 *out, real32 *out_dx, real32 *out_dy, u32 count)
+{
+	for (u32 i = 0; i < count; i++) {
+		V2 gradient;
+		out[i] = perlin_gradient(noise, { xs[i], y }, &gradient);
+		out_dx[i] = gradient.x;
+		out_dy[i] = gradient.y;
+	}
+}
+
+#ifdef PERLIN_X86
+
+// h & 3 picks (1, 1), (-1, 1), (-1, -1), (1, -1), the result is the corner's
+// dot product and gx, gy its gradient vector.
+PERLIN_TARGET("sse4.1")
+static __m128 perlin_grad_sse41(__m128i h, __m128 x, __m128 y, __m128 *gx, __m128 *gy)
+{
+	const __m128 flip_x = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_xor_si128(h, _mm_srli_epi32(h, 1)), _mm_set1_epi32(1)), 31));
+	const __m128 flip_y = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+
+	*gx = _mm_xor_ps(_mm_set1_ps(1.f), flip_x);
+	*gy = _mm_xor_ps(_mm_set1_ps(1.f), flip_y);
+
+	return _mm_add_ps(_mm_xor_ps(x, flip_x), _mm_xor_ps(y, flip_y));
+}
+
+PERLIN_TARGET("sse4.1")
+static __m128 perlin_fade_sse41(__m128 t)
+{
+	__m128 r = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(6.f), t), _mm_set1_ps(15.f));
+	r = _mm_add_ps(_mm_mul_ps(r, t), _mm_set1_ps(10.f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(r, t), t), t);
+}
+
+PERLIN_TARGET("sse4.1")
+static __m128 perlin_fade_derivative_sse41(__m128 t)
+{
+	__m128 r = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(30.f), t), _mm_set1_ps(60.f));
+	r = _mm_add_ps(_mm_mul_ps(r, t), _mm_set1_ps(30.f));
+	return _mm_mul_ps(_mm_mul_ps(r, t), t);
+}
+
+PERLIN_TARGET("sse4.1")
+static __m128 perlin_lerp_sse41(__m128 t, __m128 a, __m128 b)
+{
+	return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+PERLIN_TARGET("sse4.1")
+static void perlin_row_sse41(const NoiseContext *noise, const real32 *xs, real32 y, const PerlinRowY *row, real32 *out, real32 *out_dx, real32 *out_dy, u32 count)
+{
+	const __m128 yf = _mm_set1_ps(row->yf);
+	const __m128 yf1 = _mm_set1_ps(row->yf1);
+	const __m128 v = _mm_set1_ps(row->v);
+	const __m128 dv = _mm_set1_ps(row->dv);
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 x = _mm_loadu_ps(xs + i);
+		const __m128 fx = _mm_floor_ps(x);
+		const __m128 xf = _mm_sub_ps(x, fx);
+		const __m128 xf1 = _mm_sub_ps(xf, _mm_set1_ps(1.f));
+
+		alignas(16) s32 X[4];
+		_mm_store_si128((__m128i *)X, _mm_and_si128(_mm_cvttps_epi32(fx), _mm_set1_epi32(255)));
+
+		// No gather before AVX2, the table lookups stay scalar.
+		alignas(16) s32 bl[4], tl[4], br[4], tr[4];
+		for (u32 k = 0; k < 4; k++) {
+			const s32 a = noise->P32[X[k]] + row->Y;
+			const s32 b = noise->P32[X[k] + 1] + row->Y;
+			bl[k] = noise->P32[a];
+			tl[k] = noise->P32[a + 1];
+			br[k] = noise->P32[b];
+			tr[k] = noise->P32[b + 1];
+		}
+
+		__m128 gx_bl, gy_bl, gx_tl, gy_tl, gx_br, gy_br, gx_tr, gy_tr;
+		const __m128 dot_bl = perlin_grad_sse41(_mm_load_si128((__m128i *)bl), xf, yf, &gx_bl, &gy_bl);
+		const __m128 dot_tl = perlin_grad_sse41(_mm_load_si128((__m128i *)tl), xf, yf1, &gx_tl, &gy_tl);
+		const __m128 dot_br = perlin_grad_sse41(_mm_load_si128((__m128i *)br), xf1, yf, &gx_br, &gy_br);
+		const __m128 dot_tr = perlin_grad_sse41(_mm_load_si128((__m128i *)tr), xf1, yf1, &gx_tr, &gy_tr);
+
+		const __m128 u = perlin_fade_sse41(xf);
+		const __m128 du = perlin_fade_derivative_sse41(xf);
+
+		const __m128 left = perlin_lerp_sse41(v, dot_bl, dot_tl);
+		const __m128 right = perlin_lerp_sse41(v, dot_br, dot_tr);
+
+		const __m128 left_dx = perlin_lerp_sse41(v, gx_bl, gx_tl);
+		const __m128 right_dx = perlin_lerp_sse41(v, gx_br, gx_tr);
+		const __m128 left_dy = _mm_add_ps(perlin_lerp_sse41(v, gy_bl, gy_tl), _mm_mul_ps(dv, _mm_sub_ps(dot_tl, dot_bl)));
+		const __m128 right_dy = _mm_add_ps(perlin_lerp_sse41(v, gy_br, gy_tr), _mm_mul_ps(dv, _mm_sub_ps(dot_tr, dot_br)));
+
+		_mm_storeu_ps(out + i, perlin_lerp_sse41(u, left, right));
+		_mm_storeu_ps(out_dx + i, _mm_add_ps(perlin_lerp_sse41(u, left_dx, right_dx), _mm_mul_ps(du, _mm_sub_ps(right, left))));
+		_mm_storeu_ps(out_dy + i, perlin_lerp_sse41(u, left_dy, right_dy));
+	}
+
+	perlin_row_scalar(noise, xs + i, y, row, out + i, out_dx + i, out_dy + i, count - i);
+}
+
+PERLIN_TARGET("avx2")
+static __m256 perlin_grad_avx2(__m256i h, __m256 x, __m256 y, __m256 *gx, __m256 *gy)
+{
+	const __m256 flip_x = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(h, _mm256_srli_epi32(h, 1)), _mm256_set1_epi32(1)), 31));
+	const __m256 flip_y = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+
+	*gx = _mm256_xor_ps(_mm256_set1_ps(1.f), flip_x);
+	*gy = _mm256_xor_ps(_mm256_set1_ps(1.f), flip_y);
+
+	return _mm256_add_ps(_mm256_xor_ps(x, flip_x), _mm256_xor_ps(y, flip_y));
+}
+
+PERLIN_TARGET("avx2")
+static __m256 perlin_fade_avx2(__m256 t)
+{
+	__m256 r = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(6.f), t), _mm256_set1_ps(15.f));
+	r = _mm256_add_ps(_mm256_mul_ps(r, t), _mm256_set1_ps(10.f));
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(r, t), t), t);
+}
+
+PERLIN_TARGET("avx2")
+static __m256 perlin_fade_derivative_avx2(__m256 t)
+{
+	__m256 r = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(30.f), t), _mm256_set1_ps(60.f));
+	r = _mm256_add_ps(_mm256_mul_ps(r, t), _mm256_set1_ps(30.f));
+	return _mm256_mul_ps(_mm256_mul_ps(r, t), t);
+}
+
+PERLIN_TARGET("avx2")
+static __m256 perlin_lerp_avx2(__m256 t, __m256 a, __m256 b)
+{
+	return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+PERLIN_TARGET("avx2")
+static void perlin_row_avx2(const NoiseContext *noise, const real32 *xs, real32 y, const PerlinRowY *row, real32 *out, real32 *out_dx, real32 *out_dy, u32 count)
+{
+	const __m256 yf = _mm256_set1_ps(row->yf);
+	const __m256 yf1 = _mm256_set1_ps(row->yf1);
+	const __m256 v = _mm256_set1_ps(row->v);
+	const __m256 dv = _mm256_set1_ps(row->dv);
+	const __m256i Y = _mm256_set1_epi32(row->Y);
+	const __m256i one = _mm256_set1_epi32(1);
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 x = _mm256_loadu_ps(xs + i);
+		const __m256 fx = _mm256_floor_ps(x);
+		const __m256 xf = _mm256_sub_ps(x, fx);
+		const __m256 xf1 = _mm256_sub_ps(xf, _mm256_set1_ps(1.f));
+		const __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(255));
+
+		const __m256i a = _mm256_add_epi32(_mm256_i32gather_epi32(noise->P32, X, 4), Y);
+		const __m256i b = _mm256_add_epi32(_mm256_i32gather_epi32(noise->P32, _mm256_add_epi32(X, one), 4), Y);
+
+		__m256 gx_bl, gy_bl, gx_tl, gy_tl, gx_br, gy_br, gx_tr, gy_tr;
+		const __m256 dot_bl = perlin_grad_avx2(_mm256_i32gather_epi32(noise->P32, a, 4), xf, yf, &gx_bl, &gy_bl);
+		const __m256 dot_tl = perlin_grad_avx2(_mm256_i32gather_epi32(noise->P32, _mm256_add_epi32(a, one), 4), xf, yf1, &gx_tl, &gy_tl);
+		const __m256 dot_br = perlin_grad_avx2(_mm256_i32gather_epi32(noise->P32, b, 4), xf1, yf, &gx_br, &gy_br);
+		const __m256 dot_tr = perlin_grad_avx2(_mm256_i32gather_epi32(noise->P32, _mm256_add_epi32(b, one), 4), xf1, yf1, &gx_tr, &gy_tr);
+
+		const __m256 u = perlin_fade_avx2(xf);
+		const __m256 du = perlin_fade_derivative_avx2(xf);
+
+		const __m256 left = perlin_lerp_avx2(v, dot_bl, dot_tl);
+		const __m256 right = perlin_lerp_avx2(v, dot_br, dot_tr);
+
+		const __m256 left_dx = perlin_lerp_avx2(v, gx_bl, gx_tl);
+		const __m256 right_dx = perlin_lerp_avx2(v, gx_br, gx_tr);
+		const __m256 left_dy = _mm256_add_ps(perlin_lerp_avx2(v, gy_bl, gy_tl), _mm256_mul_ps(dv, _mm256_sub_ps(dot_tl, dot_bl)));
+		const __m256 right_dy = _mm256_add_ps(perlin_lerp_avx2(v, gy_br, gy_tr), _mm256_mul_ps(dv, _mm256_sub_ps(dot_tr, dot_br)));
+
+		_mm256_storeu_ps(out + i, perlin_lerp_avx2(u, left, right));
+		_mm256_storeu_ps(out_dx + i, _mm256_add_ps(perlin_lerp_avx2(u, left_dx, right_dx), _mm256_mul_ps(du, _mm256_sub_ps(right, left))));
+		_mm256_storeu_ps(out_dy + i, perlin_lerp_avx2(u, left_dy, right_dy));
+	}
+
+	perlin_row_scalar(noise, xs + i, y, row, out + i, out_dx + i, out_dy + i, count - i);
+}
+
+// AVX-512F brings FMA with it and the compiler will happily fuse plain
+// vector multiplies and adds, which breaks the match with perlin(). The
+// explicitly rounded forms are never contracted.
+PERLIN_TARGET("avx512f")
+static __m512 avx512_add(__m512 a, __m512 b)
+{
+	return _mm512_add_round_ps(a, b, _MM_FROUND_CUR_DIRECTION);
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 avx512_sub(__m512 a, __m512 b)
+{
+	return _mm512_sub_round_ps(a, b, _MM_FROUND_CUR_DIRECTION);
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 avx512_mul(__m512 a, __m512 b)
+{
+	return _mm512_mul_round_ps(a, b, _MM_FROUND_CUR_DIRECTION);
+}
+
+// AVX-512F has no float xor, the sign bits are flipped as integers.
+PERLIN_TARGET("avx512f")
+static __m512 avx512_flip(__m512 a, __m512i flip)
+{
+	return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), flip));
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 perlin_grad_avx512(__m512i h, __m512 x, __m512 y, __m512 *gx, __m512 *gy)
+{
+	const __m512i flip_x = _mm512_slli_epi32(_mm512_and_si512(_mm512_xor_si512(h, _mm512_srli_epi32(h, 1)), _mm512_set1_epi32(1)), 31);
+	const __m512i flip_y = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(2)), 30);
+
+	*gx = avx512_flip(_mm512_set1_ps(1.f), flip_x);
+	*gy = avx512_flip(_mm512_set1_ps(1.f), flip_y);
+
+	return avx512_add(avx512_flip(x, flip_x), avx512_flip(y, flip_y));
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 perlin_fade_avx512(__m512 t)
+{
+	__m512 r = avx512_sub(avx512_mul(_mm512_set1_ps(6.f), t), _mm512_set1_ps(15.f));
+	r = avx512_add(avx512_mul(r, t), _mm512_set1_ps(10.f));
+	return avx512_mul(avx512_mul(avx512_mul(r, t), t), t);
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 perlin_fade_derivative_avx512(__m512 t)
+{
+	__m512 r = avx512_sub(avx512_mul(_mm512_set1_ps(30.f), t), _mm512_set1_ps(60.f));
+	r = avx512_add(avx512_mul(r, t), _mm512_set1_ps(30.f));
+	return avx512_mul(avx512_mul(r, t), t);
+}
+
+PERLIN_TARGET("avx512f")
+static __m512 perlin_lerp_avx512(__m512 t, __m512 a, __m512 b)
+{
+	return avx512_add(a, avx512_mul(t, avx512_sub(b, a)));
+}
+
+PERLIN_TARGET("avx512f")
+static void perlin_row_avx512(const NoiseContext *noise, const real32 *xs, real32, const PerlinRowY *row, real32 *out, real32 *out_dx, real32 *out_dy, u32 count)
+{
+	const __m512 yf = _mm512_set1_ps(row->yf);
+	const __m512 yf1 = _mm512_set1_ps(row->yf1);
+	const __m512 v = _mm512_set1_ps(row->v);
+	const __m512 dv = _mm512_set1_ps(row->dv);
+	const __m512i Y = _mm512_set1_epi32(row->Y);
+	const __m512i one = _mm512_set1_epi32(1);
+
+	// The tail is done with a masked load and store, the masked lanes read as
+	// zero which still gives valid table indices.
+	for (u32 i = 0; i < count; i += 16) {
+		const __mmask16 mask = count - i >= 16 ? 0xffff : (__mmask16)((1u << (count - i)) - 1);
+
+		const __m512 x = _mm512_maskz_loadu_ps(mask, xs + i);
+		const __m512 fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		const __m512 xf = avx512_sub(x, fx);
+		const __m512 xf1 = avx512_sub(xf, _mm512_set1_ps(1.f));
+		const __m512i X = _mm512_and_si512(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(255));
+
+		const __m512i a = _mm512_add_epi32(_mm512_i32gather_epi32(X, noise->P32, 4), Y);
+		const __m512i b = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(X, one), noise->P32, 4), Y);
+
+		__m512 gx_bl, gy_bl, gx_tl, gy_tl, gx_br, gy_br, gx_tr, gy_tr;
+		const __m512 dot_bl = perlin_grad_avx512(_mm512_i32gather_epi32(a, noise->P32, 4), xf, yf, &gx_bl, &gy_bl);
+		const __m512 dot_tl = perlin_grad_avx512(_mm512_i32gather_epi32(_mm512_add_epi32(a, one), noise->P32, 4), xf, yf1, &gx_tl, &gy_tl);
+		const __m512 dot_br = perlin_grad_avx512(_mm512_i32gather_epi32(b, noise->P32, 4), xf1, yf, &gx_br, &gy_br);
+		const __m512 dot_tr = perlin_grad_avx512(_mm512_i32gather_epi32(_mm512_add_epi32(b, one), noise->P32, 4), xf1, yf1, &gx_tr, &gy_tr);
+
+		const __m512 u = perlin_fade_avx512(xf);
+		const __m512 du = perlin_fade_derivative_avx512(xf);
+
+		const __m512 left = perlin_lerp_avx512(v, dot_bl, dot_tl);
+		const __m512 right = perlin_lerp_avx512(v, dot_br, dot_tr);
+
+		const __m512 left_dx = perlin_lerp_avx512(v, gx_bl, gx_tl);
+		const __m512 right_dx = perlin_lerp_avx512(v, gx_br, gx_tr);
+		const __m512 left_dy = avx512_add(perlin_lerp_avx512(v, gy_bl, gy_tl), avx512_mul(dv, avx512_sub(dot_tl, dot_bl)));
+		const __m512 right_dy = avx512_add(perlin_lerp_avx512(v, gy_br, gy_tr), avx512_mul(dv, avx512_sub(dot_tr, dot_br)));
+
+		_mm512_mask_storeu_ps(out + i, mask, perlin_lerp_avx512(u, left, right));
+		_mm512_mask_storeu_ps(out_dx + i, mask, avx512_add(perlin_lerp_avx512(u, left_dx, right_dx), avx512_mul(du, avx512_sub(right, left))));
+		_mm512_mask_storeu_ps(out_dy + i, mask, perlin_lerp_avx512(u, left_dy, right_dy));
+	}
+}
+
+static bool32 cpu_supports(PerlinKernel kernel)
+{
+#ifdef _MSC_VER
+	s32 info[4];
+	__cpuid(info, 0);
+	const s32 max_leaf = info[0];
+
+	__cpuid(info, 1);
+	const bool32 sse41 = (info[2] >> 19) & 1;
+	const bool32 osxsave = (info[2] >> 27) & 1;
+	const bool32 avx = (info[2] >> 28) & 1;
+
+	// The OS has to save the wider registers on a context switch too.
+	const u64 xcr0 = osxsave ? _xgetbv(0) : 0;
+	const bool32 ymm_state = (xcr0 & 0x6) == 0x6;
+	const bool32 zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+	bool32 avx2 = false;
+	bool32 avx512f = false;
+	if (max_leaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] >> 5) & 1;
+		avx512f = (info[1] >> 16) & 1;
+	}
+
+	switch (kernel) {
+		case PERLIN_KERNEL_SSE41: return sse41;
+		case PERLIN_KERNEL_AVX2: return avx && avx2 && ymm_state;
+		case PERLIN_KERNEL_AVX512: return avx && avx2 && avx512f && zmm_state;
+		default: return true;
+	}
+#else
+	__builtin_cpu_init();
+
+	switch (kernel) {
+		case PERLIN_KERNEL_SSE41: return __builtin_cpu_supports("sse4.1");
+		case PERLIN_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+		case PERLIN_KERNEL_AVX512: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f");
+		default: return true;
+	}
+#endif
+}
+
+#else
+
+static bool32 cpu_supports(PerlinKernel kernel)
+{
+	return kernel == PERLIN_KERNEL_SCALAR;
+}
+
+#endif
+
+typedef void (*perlin_row_func)(const NoiseContext *noise, const real32 *xs, real32 y, const PerlinRowY *row, real32 *out, real32 *out_dx, real32 *out_dy, u32 count);
+
+static perlin_row_func kernel_func(PerlinKernel kernel)
+{
+	switch (kernel) {
+#ifdef PERLIN_X86
+		case PERLIN_KERNEL_SSE41: return perlin_row_sse41;
+		case PERLIN_KERNEL_AVX2: return perlin_row_avx2;
+		case PERLIN_KERNEL_AVX512: return perlin_row_avx512;
+#endif
+		default: return perlin_row_scalar;
+	}
+}
+
+static PerlinKernel current_kernel = perlin_best_kernel();
+static perlin_row_func current_row_func = kernel_func(current_kernel);
+
+PerlinKernel perlin_best_kernel()
+{
+	for (s32 kernel = PERLIN_KERNEL_COUNT - 1; kernel > PERLIN_KERNEL_SCALAR; kernel--) {
+		if (cpu_supports((PerlinKernel)kernel)) {
+			return (PerlinKernel)kernel;
+		}
+	}
+
+	return PERLIN_KERNEL_SCALAR;
+}
+
+bool32 perlin_set_kernel(PerlinKernel kernel)
+{
+	if (kernel < 0 || kernel >= PERLIN_KERNEL_COUNT || !cpu_supports(kernel)) {
+		return false;
+	}
+
+	current_kernel = kernel;
+	current_row_func = kernel_func(kernel);
+
+	return true;
+}
+
+PerlinKernel perlin_get_kernel()
+{
+	return current_kernel;
+}
+
+const char *perlin_kernel_name(PerlinKernel kernel)
+{
+	switch (kernel) {
+		case PERLIN_KERNEL_SSE41: return "sse4.1";
+		case PERLIN_KERNEL_AVX2: return "avx2";
+		case PERLIN_KERNEL_AVX512: return "avx512";
+		default: return "scalar";
+	}
+}
+
+void perlin_row(const NoiseContext *noise, const real32 *xs, real32 y, real32 *out, real32 *out_dx, real32 *out_dy, u32 count)
+{
+	// Done out here so the kernels' wider instruction sets can't fuse it.
+	const PerlinRowY row = perlin_row_y(y);
+	current_row_func(noise, xs, y, &row, out, out_dx, out_dy, count);
+}
@@ -1,12 +1,43 @@
 #ifndef PERLIN_H
 #define PERLIN_H
 
-#include <random>
-
 #include "types.h"
 #include "maths.h"
 
-extern real32 perlin(V2 p);
-extern void seed_perlin(std::mt19937 &rng);
+// Row kernels, picked at startup from what the CPU supports.
+enum PerlinKernel {
+    PERLIN_KERNEL_SCALAR,
+    PERLIN_KERNEL_SSE41,
+    PERLIN_KERNEL_AVX2,
+    PERLIN_KERNEL_AVX512,
+    PERLIN_KERNEL_COUNT
+};
+
+// The permutation table for one seed. Nothing else is shared, so any number
+// of contexts can be seeded and sampled from different threads at once.
+struct NoiseContext {
+    u8 P[512];
+    // The same table widened so the SIMD kernels can gather from it.
+    s32 P32[512];
+    // Bumped on every reseed so anything cached from the noise can tell it's stale.
+    u32 revision;
+};
+
+extern real32 perlin(const NoiseContext *noise, V2 p);
+// Also returns the analytic partial derivatives d/dx and d/dy of the noise.
+extern real32 perlin_gradient(const NoiseContext *noise, V2 p, V2 *gradient);
+extern void seed_perlin(NoiseContext *noise, u32 seed);
+
+// perlin_gradient(noise, { xs[i], y }) for a whole row, the value goes to
+// out and the derivatives to out_dx and out_dy. See perlin.cpp for the
+// accuracy of the SIMD kernels against the scalar path.
+extern void perlin_row(const NoiseContext *noise, const real32 *xs, real32 y, real32 *out, real32 *out_dx, real32 *out_dy, u32 count);
+
+extern PerlinKernel perlin_best_kernel();
+extern PerlinKernel perlin_get_kernel();
+// Returns false if the CPU can't run the kernel. Not thread safe, call
+// before generating.
+extern bool32 perlin_set_kernel(PerlinKernel kernel);
+extern const char *perlin_kernel_name(PerlinKernel kernel);
 
 #endif
\ No newline at end of file
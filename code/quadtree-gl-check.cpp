@@ -0,0 +1,499 @@
+// Headless check of the quadtree terrain shaders on an EGL context. Compiles
+// and links the quadtree and terrain depth shaders, then draws a preset's
+// quadtree from a few cameras with morphing on, capturing where the vertex
+// shader puts every grid vertex with transform feedback. Each vertex on the
+// edge between two drawn nodes has to stay on that edge and on the
+// neighbour's side of it, anything else is a crack. Exits with 77, which ctest
+// takes as skipped, when there's no OpenGL 3.3 core context to run on.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "types.h"
+#include "maths.h"
+#include "world.h"
+#include "perlin.h"
+#include "quadtree.h"
+#include "shaders.h"
+
+#define CHECK_SKIPPED 77
+
+// How far a vertex may be from its neighbour's edge, in world units.
+#define CHECK_POSITION_TOLERANCE 1e-3f
+#define CHECK_HEIGHT_TOLERANCE 1e-3f
+
+enum PatchSide {
+	PATCH_SIDE_MIN_X,
+	PATCH_SIDE_MAX_X,
+	PATCH_SIDE_MIN_Z,
+	PATCH_SIDE_MAX_Z,
+	PATCH_SIDE_COUNT
+};
+
+// One draw's captured vertices. Vertices on the x sides are sorted by z and
+// those on the z sides by x.
+struct DrawPatch {
+	real32 min[2], max[2]; // World x and z, clamped to the world's edge.
+	std::vector<V3> sides[PATCH_SIDE_COUNT];
+};
+
+struct CrackCheck {
+	u32 vertices;
+	u32 morphing; // Part way between their grid and the next level's.
+	u32 edge_vertices;
+	u32 failures;
+	real32 max_height_error;
+};
+
+// Prefers Mesa's surfaceless platform, which needs no display server.
+static bool32 create_context()
+{
+	const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless")) {
+		display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+	}
+
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0) || !eglBindAPI(EGL_OPENGL_API)) {
+		return false;
+	}
+
+	// Nothing is drawn to a surface, so no config is fine where it's allowed.
+	const EGLint config_attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count < 1) {
+		config = EGL_NO_CONFIG_KHR;
+	}
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static u32 compile_shader(const char *name, const char *source, GLenum type)
+{
+	u32 shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, 0);
+	glCompileShader(shader);
+
+	GLint compiled = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		char log[4096];
+		glGetShaderInfoLog(shader, sizeof(log), 0, log);
+		fprintf(stderr, "%s %s shader failed to compile:\n%s\n", name, type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+// Links the pair as the app does, capturing v_pos with transform feedback if
+// asked. Returns 0 if either shader fails.
+static u32 link_program(const char *name, const char *vertex_source, const char *fragment_source, bool32 capture_position)
+{
+	const u32 vertex = compile_shader(name, vertex_source, GL_VERTEX_SHADER);
+	const u32 fragment = compile_shader(name, fragment_source, GL_FRAGMENT_SHADER);
+	if (!vertex || !fragment) {
+		return 0;
+	}
+
+	u32 program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+
+	if (capture_position) {
+		const char *varyings[] = { "v_pos" };
+		glTransformFeedbackVaryings(program, 1, varyings, GL_INTERLEAVED_ATTRIBS);
+	}
+
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof(log), 0, log);
+		fprintf(stderr, "%s program failed to link:\n%s\n", name, log);
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	printf("%s: compiled and linked\n", name);
+	return program;
+}
+
+static u32 create_map_texture(GLint internal_format, GLenum format, GLenum type, u32 length, const void *pixels)
+{
+	u32 tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, length, length, 0, format, type, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+// The neighbour's height along its side at t, straight between its vertices
+// as the triangles along the side are. False if t is past either end.
+static bool32 side_height_at(const std::vector<V3> *side, u32 axis, real32 t, real32 *height)
+{
+	for (u32 i = 0; i + 1 < side->size(); i++) {
+		const real32 a = (*side)[i].E[axis];
+		const real32 b = (*side)[i + 1].E[axis];
+
+		if (t >= a - CHECK_POSITION_TOLERANCE && t <= b + CHECK_POSITION_TOLERANCE) {
+			const real32 s = b - a > CHECK_POSITION_TOLERANCE ? (t - a) / (b - a) : 0.f;
+			const real32 clamped = s < 0.f ? 0.f : (s > 1.f ? 1.f : s);
+			*height = (*side)[i].y + ((*side)[i + 1].y - (*side)[i].y) * clamped;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void check_patch_edges(const std::vector<DrawPatch> *patches, real32 world_length, CrackCheck *check)
+{
+	for (u32 a = 0; a < patches->size(); a++) {
+		const DrawPatch *patch = &(*patches)[a];
+
+		for (u32 side = 0; side < PATCH_SIDE_COUNT; side++) {
+			// 0 for the x sides, 1 for z. Positions are x, y, z so the
+			// coordinate along the side is the other one.
+			const u32 across = side / 2;
+			const u32 along_axis = across == 0 ? 2 : 0;
+			const u32 across_axis = across == 0 ? 0 : 2;
+			const bool32 is_max = side % 2;
+			const real32 line = is_max ? patch->max[across] : patch->min[across];
+
+			// Nothing to meet on the world's edge.
+			if (line <= 0.f || line >= world_length) {
+				continue;
+			}
+
+			for (const V3 &vertex : patch->sides[side]) {
+				check->edge_vertices++;
+
+				if (fabsf(vertex.E[across_axis] - line) > CHECK_POSITION_TOLERANCE) {
+					if (check->failures++ < 10) {
+						fprintf(stderr, "vertex (%.3f, %.3f) left its node's edge at %.1f\n", vertex.x, vertex.z, line);
+					}
+					continue;
+				}
+
+				const real32 t = vertex.E[along_axis];
+				u32 neighbours = 0;
+
+				for (u32 b = 0; b < patches->size(); b++) {
+					const DrawPatch *other = &(*patches)[b];
+					const real32 other_line = is_max ? other->min[across] : other->max[across];
+					const u32 along = 1 - across;
+
+					if (b == a || fabsf(other_line - line) > CHECK_POSITION_TOLERANCE ||
+						t < other->min[along] - CHECK_POSITION_TOLERANCE || t > other->max[along] + CHECK_POSITION_TOLERANCE) {
+						continue;
+					}
+
+					real32 height;
+					if (!side_height_at(&other->sides[side ^ 1], along_axis, t, &height)) {
+						continue;
+					}
+
+					neighbours++;
+
+					const real32 error = fabsf(height - vertex.y);
+					check->max_height_error = error > check->max_height_error ? error : check->max_height_error;
+
+					if (error > CHECK_HEIGHT_TOLERANCE && check->failures++ < 10) {
+						fprintf(stderr, "crack at (%.3f, %.3f): height %.4f, neighbour %.4f\n", vertex.x, vertex.z, vertex.y, height);
+					}
+				}
+
+				if (!neighbours && check->failures++ < 10) {
+					fprintf(stderr, "gap at (%.3f, %.3f): no node on the other side\n", vertex.x, vertex.z);
+				}
+			}
+		}
+	}
+}
+
+// Selects and draws everything in range of the camera, frustum or not, and
+// checks where the grid vertices ended up.
+static void check_camera(const TerrainQuadtree *quadtree, u32 program, u32 capture_buffer, V3 camera_pos, CrackCheck *check)
+{
+	const u32 grid_vertices_length = QUADTREE_GRID_TILES + 1;
+	const real32 world_length = (real32)(quadtree->map_length - 1);
+
+	std::vector<QuadtreeDraw> draws;
+	quadtree_select(quadtree, camera_pos, 0, &draws);
+
+	u32 captured_count = 0;
+	for (const QuadtreeDraw &draw : draws) {
+		captured_count += quadtree->grid_ranges[draw.quadrant].count;
+	}
+
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, capture_buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, (u64)captured_count * sizeof(V3), 0, GL_STATIC_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, capture_buffer);
+
+	glUniform3f(glGetUniformLocation(program, "view_position"), camera_pos.x, camera_pos.y, camera_pos.z);
+
+	const s32 node_handle = glGetUniformLocation(program, "node");
+	const s32 morph_handle = glGetUniformLocation(program, "morph");
+
+	// Every index as a point, so the capture lines up with grid_indices.
+	glBeginTransformFeedback(GL_POINTS);
+	for (const QuadtreeDraw &draw : draws) {
+		const QuadtreeNode *node = &quadtree->nodes[draw.node];
+		const real32 morph_start = quadtree->morph_starts[node->level];
+		const real32 morph_end = quadtree->ranges[node->level];
+
+		glUniform4f(node_handle, (real32)node->x, (real32)node->z, (real32)(1 << node->level), 0.f);
+		glUniform2f(morph_handle, morph_start, morph_end > morph_start ? 1.f / (morph_end - morph_start) : 0.f);
+
+		const IndexRange *range = &quadtree->grid_ranges[draw.quadrant];
+		glDrawElements(GL_POINTS, range->count, GL_UNSIGNED_SHORT, (void *)(range->offset * sizeof(u16)));
+	}
+	glEndTransformFeedback();
+
+	std::vector<V3> captured(captured_count);
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, captured.size() * sizeof(V3), captured.data());
+
+	std::vector<DrawPatch> patches(draws.size());
+	u32 offset = 0;
+
+	for (u32 i = 0; i < draws.size(); i++) {
+		const QuadtreeNode *node = &quadtree->nodes[draws[i].node];
+		const IndexRange *range = &quadtree->grid_ranges[draws[i].quadrant];
+		const real32 step = (real32)(1 << node->level);
+		const real32 corner[2] = { (real32)node->x, (real32)node->z };
+
+		u32 grid_min[2] = { grid_vertices_length, grid_vertices_length };
+		u32 grid_max[2] = { 0, 0 };
+
+		for (u32 k = 0; k < range->count; k++) {
+			const u32 index = quadtree->grid_indices[range->offset + k];
+			const u32 grid[2] = { index % grid_vertices_length, index / grid_vertices_length };
+
+			for (u32 axis = 0; axis < 2; axis++) {
+				grid_min[axis] = grid[axis] < grid_min[axis] ? grid[axis] : grid_min[axis];
+				grid_max[axis] = grid[axis] > grid_max[axis] ? grid[axis] : grid_max[axis];
+			}
+		}
+
+		DrawPatch *patch = &patches[i];
+		for (u32 axis = 0; axis < 2; axis++) {
+			patch->min[axis] = fminf(corner[axis] + grid_min[axis] * step, world_length);
+			patch->max[axis] = fminf(corner[axis] + grid_max[axis] * step, world_length);
+		}
+
+		for (u32 k = 0; k < range->count; k++) {
+			const u32 index = quadtree->grid_indices[range->offset + k];
+			const u32 grid[2] = { index % grid_vertices_length, index / grid_vertices_length };
+			const V3 vertex = captured[offset + k];
+			const real32 position[2] = { vertex.x, vertex.z };
+
+			check->vertices++;
+
+			// Odd vertices slide a whole step by the end of the morph.
+			for (u32 axis = 0; axis < 2; axis++) {
+				const real32 grid_position = corner[axis] + grid[axis] * step;
+				const real32 k_morph = (grid_position - position[axis]) / step;
+
+				if (grid[axis] % 2 && grid_position < world_length && k_morph > 0.01f && k_morph < 0.99f) {
+					check->morphing++;
+					break;
+				}
+			}
+
+			if (grid[0] == grid_min[0]) patch->sides[PATCH_SIDE_MIN_X].push_back(vertex);
+			if (grid[0] == grid_max[0]) patch->sides[PATCH_SIDE_MAX_X].push_back(vertex);
+			if (grid[1] == grid_min[1]) patch->sides[PATCH_SIDE_MIN_Z].push_back(vertex);
+			if (grid[1] == grid_max[1]) patch->sides[PATCH_SIDE_MAX_Z].push_back(vertex);
+		}
+
+		for (u32 side = 0; side < PATCH_SIDE_COUNT; side++) {
+			const u32 along_axis = side < PATCH_SIDE_MIN_Z ? 2 : 0;
+			std::sort(patch->sides[side].begin(), patch->sides[side].end(), [along_axis](const V3 &a, const V3 &b) {
+				return a.E[along_axis] < b.E[along_axis];
+			});
+		}
+
+		offset += range->count;
+	}
+
+	check_patch_edges(&patches, world_length, check);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("usage: %s <preset.world>\n", argv[0]);
+		return 1;
+	}
+
+	if (!create_context()) {
+		printf("No OpenGL 3.3 core context, skipping\n");
+		return CHECK_SKIPPED;
+	}
+
+	printf("%s, %s\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+
+	using namespace Shaders;
+
+	const u32 quadtree_program = link_program("quadtree", QUADTREE_VERTEX_SHADER_SOURCE, DEFAULT_FRAGMENT_SHADER_SOURCE, false);
+	const u32 terrain_depth_program = link_program("terrain depth", TERRAIN_DEPTH_VERTEX_SHADER_SOURCE, DEPTH_FRAGMENT_SHADER_SOURCE, false);
+	const u32 capture_program = link_program("quadtree capture", QUADTREE_VERTEX_SHADER_SOURCE, DEFAULT_FRAGMENT_SHADER_SOURCE, true);
+
+	if (!quadtree_program || !terrain_depth_program || !capture_program) {
+		return 1;
+	}
+
+	preset_file preset = {};
+	if (!load_preset_file(argv[1], &preset)) {
+		fprintf(stderr, "Failed to read preset %s\n", argv[1]);
+		return 1;
+	}
+
+	JobSystem *jobs = new JobSystem();
+	job_system_init(jobs);
+
+	World *world = new World();
+	world->params = &preset.params;
+	world->jobs = jobs;
+
+	init_terrain(world, preset.params.chunk_tile_length, preset.params.world_width);
+	seed_perlin(&world->noise, preset.params.seed);
+	generate_terrain_chunks(world);
+
+	TerrainQuadtree *quadtree = new TerrainQuadtree();
+	build_quadtree(world, quadtree);
+
+	// Past any real tolerance so every level gets the narrowest band it can,
+	// which puts several levels and their morphs in view of a small world.
+	const real32 fov_y = radians(60.f);
+	quadtree_update_ranges(quadtree, 1080.f / (2.f * tanf(fov_y / 2.f)), 1e6f);
+
+	u32 vao, grid_vbo, grid_ebo, capture_buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	const u32 grid_vertices_length = QUADTREE_GRID_TILES + 1;
+	std::vector<V2> grid(grid_vertices_length * grid_vertices_length);
+	for (u32 i = 0; i < grid.size(); i++) {
+		grid[i] = { (real32)(i % grid_vertices_length), (real32)(i / grid_vertices_length) };
+	}
+
+	glGenBuffers(1, &grid_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, grid_vbo);
+	glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(V2), grid.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(V2), (void *)0);
+	glEnableVertexAttribArray(0);
+
+	glGenBuffers(1, &grid_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, quadtree->grid_indices.size() * sizeof(u16), quadtree->grid_indices.data(), GL_STATIC_DRAW);
+
+	glActiveTexture(GL_TEXTURE0);
+	const u32 height_texture = create_map_texture(GL_R32F, GL_RED, GL_FLOAT, quadtree->map_length, quadtree->heights.data());
+	glActiveTexture(GL_TEXTURE1);
+	const u32 normal_texture = create_map_texture(GL_RG16_SNORM, GL_RG, GL_SHORT, quadtree->map_length, quadtree->normals.data());
+	glActiveTexture(GL_TEXTURE0);
+
+	glGenBuffers(1, &capture_buffer);
+
+	// There's no default framebuffer without a surface and drawing needs a
+	// complete one, even with the rasteriser off.
+	u32 fbo, colour_buffer;
+	glGenRenderbuffers(1, &colour_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colour_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_buffer);
+
+	glUseProgram(capture_program);
+	glUniform1f(glGetUniformLocation(capture_program, "world_length"), (real32)world->world_tile_length);
+	glUniform1i(glGetUniformLocation(capture_program, "height_map"), 0);
+	glUniform1i(glGetUniformLocation(capture_program, "normal_map"), 1);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	// Over the middle, near a corner and off one side, each close to the
+	// ground and well above it.
+	const real32 world_length = (real32)world->world_tile_length;
+	const QuadtreeNode *root = &quadtree->nodes[0];
+	const V2 camera_spots[] = { { .5f, .5f }, { .1f, .15f }, { .8f, .35f } };
+	const real32 camera_heights[] = { root->min_height + 2.f, root->max_height + 50.f };
+
+	CrackCheck check = {};
+
+	for (const V2 &spot : camera_spots) {
+		for (real32 height : camera_heights) {
+			check_camera(quadtree, capture_program, capture_buffer, { spot.x * world_length, height, spot.y * world_length }, &check);
+		}
+	}
+
+	printf("%u levels, %u vertices (%u morphing), %u on edges between nodes, largest height error %g\n",
+		quadtree->levels, check.vertices, check.morphing, check.edge_vertices, check.max_height_error);
+
+	if (!check.morphing) {
+		fprintf(stderr, "No vertex was part way through a morph, nothing was checked\n");
+		check.failures++;
+	}
+
+	glDeleteTextures(1, &height_texture);
+	glDeleteTextures(1, &normal_texture);
+	glDeleteBuffers(1, &grid_vbo);
+	glDeleteBuffers(1, &grid_ebo);
+	glDeleteBuffers(1, &capture_buffer);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &colour_buffer);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(quadtree_program);
+	glDeleteProgram(terrain_depth_program);
+	glDeleteProgram(capture_program);
+
+	delete quadtree;
+	free_world(world);
+	delete world;
+
+	job_system_shutdown(jobs);
+	delete jobs;
+
+	if (check.failures) {
+		fprintf(stderr, "%u failures\n", check.failures);
+		return 1;
+	}
+
+	printf("No cracks\n");
+	return 0;
+}
@@ -0,0 +1,324 @@
+#include "quadtree.h"
+
+#include <float.h>
+
+// Corner triangles match the chunk LODs, split bottom-left to top-right.
+static void build_quadtree_grid(TerrainQuadtree *quadtree)
+{
+	const u32 grid_vertices_length = QUADTREE_GRID_TILES + 1;
+	const u32 half = QUADTREE_GRID_TILES / 2;
+
+	quadtree->grid_indices.clear();
+
+	// Quadrant by quadrant so each is a range of its own and together they
+	// are the whole node.
+	for (u32 quadrant = 0; quadrant < QUADTREE_QUADRANT_ALL; quadrant++) {
+		const u32 x0 = (quadrant & 1) * half;
+		const u32 z0 = (quadrant >> 1) * half;
+
+		IndexRange *range = &quadtree->grid_ranges[quadrant];
+		range->offset = quadtree->grid_indices.size();
+
+		for (u32 j = z0; j < z0 + half; j++) {
+			for (u32 i = x0; i < x0 + half; i++) {
+				const u16 v0 = (u16)(j * grid_vertices_length + i);
+				const u16 v1 = v0 + 1;
+				const u16 v2 = v0 + grid_vertices_length;
+				const u16 v3 = v2 + 1;
+
+				quadtree->grid_indices.push_back(v3); // Top-right
+				quadtree->grid_indices.push_back(v1); // Bottom-right
+				quadtree->grid_indices.push_back(v0); // Bottom-left
+				quadtree->grid_indices.push_back(v2); // Top-left
+				quadtree->grid_indices.push_back(v3);
+				quadtree->grid_indices.push_back(v0);
+			}
+		}
+
+		range->count = (u32)(quadtree->grid_indices.size() - range->offset);
+	}
+
+	quadtree->grid_ranges[QUADTREE_QUADRANT_ALL] = { 0, (u32)quadtree->grid_indices.size() };
+}
+
+// Every chunk shares its border vertices with the next, the last chunk in a
+// row or column owns the world's far edge.
+static void gather_quadtree_maps(const World *world, TerrainQuadtree *quadtree)
+{
+	const u32 chunk_tile_length = world->params->chunk_tile_length;
+	const u32 world_width = world->params->world_width;
+	const u32 map_length = quadtree->map_length;
+
+	quadtree->heights.resize((u64)map_length * map_length);
+	quadtree->normals.resize((u64)map_length * map_length * 2);
+
+	job_parallel_for(world->jobs, map_length, [world, quadtree, chunk_tile_length, world_width, map_length](u32 z) {
+		u32 chunk_z = z / chunk_tile_length;
+		chunk_z = chunk_z < world_width ? chunk_z : world_width - 1;
+		const u32 local_z = z - chunk_z * chunk_tile_length;
+
+		for (u32 x = 0; x < map_length; x++) {
+			u32 chunk_x = x / chunk_tile_length;
+			chunk_x = chunk_x < world_width ? chunk_x : world_width - 1;
+			const u32 local_x = x - chunk_x * chunk_tile_length;
+
+			const Chunk *chunk = world->chunks[chunk_z * world_width + chunk_x];
+			const ChunkVertex *vertex = &chunk->vertices[local_z * world->chunk_vertices_length + local_x];
+
+			const u64 index = (u64)z * map_length + x;
+			quadtree->heights[index] = vertex->height;
+			quadtree->normals[index * 2] = vertex->normal[0];
+			quadtree->normals[index * 2 + 1] = vertex->normal[1];
+		}
+	});
+}
+
+// Like a chunk's LOD errors but over the whole map. The last cell of a level
+// is cut short at the world's edge the same way the grid mesh is clamped.
+static real32 measure_quadtree_level_error(const TerrainQuadtree *quadtree, u32 level)
+{
+	const u32 step = 1 << level;
+	const u32 map_length = quadtree->map_length;
+	const u32 world_length = map_length - 1;
+	const real32 *heights = quadtree->heights.data();
+
+	real32 error = 0;
+
+	for (u32 j = 0; j < map_length; j++) {
+		u32 j0 = (j / step) * step;
+		j0 = j0 < world_length ? j0 : world_length - step;
+		const u32 j1 = j0 + step < world_length ? j0 + step : world_length;
+		const real32 w = (real32)(j - j0) / (j1 - j0);
+
+		for (u32 i = 0; i < map_length; i++) {
+			u32 i0 = (i / step) * step;
+			i0 = i0 < world_length ? i0 : world_length - step;
+			const u32 i1 = i0 + step < world_length ? i0 + step : world_length;
+			const real32 u = (real32)(i - i0) / (i1 - i0);
+
+			const real32 h0 = heights[(u64)j0 * map_length + i0]; // Bottom-left
+			const real32 h1 = heights[(u64)j0 * map_length + i1]; // Bottom-right
+			const real32 h2 = heights[(u64)j1 * map_length + i0]; // Top-left
+			const real32 h3 = heights[(u64)j1 * map_length + i1]; // Top-right
+
+			real32 level_height;
+			if (u > w) {
+				level_height = h0 + u * (h1 - h0) + w * (h3 - h1);
+			} else {
+				level_height = h0 + w * (h2 - h0) + u * (h3 - h2);
+			}
+
+			const real32 difference = fabsf(heights[(u64)j * map_length + i] - level_height);
+			error = difference > error ? difference : error;
+		}
+	}
+
+	return error;
+}
+
+static u32 build_quadtree_node(TerrainQuadtree *quadtree, u32 x, u32 z, u32 level)
+{
+	const u32 world_length = quadtree->map_length - 1;
+	const u32 size = QUADTREE_GRID_TILES << level;
+
+	const u32 index = (u32)quadtree->nodes.size();
+	quadtree->nodes.push_back({});
+
+	QuadtreeNode node = {};
+	node.x = x;
+	node.z = z;
+	node.size = size;
+	node.level = level;
+	node.min_height = FLT_MAX;
+	node.max_height = -FLT_MAX;
+
+	if (level == 0) {
+		const u32 x1 = x + size < world_length ? x + size : world_length;
+		const u32 z1 = z + size < world_length ? z + size : world_length;
+
+		for (u32 j = z; j <= z1; j++) {
+			for (u32 i = x; i <= x1; i++) {
+				const real32 height = quadtree->heights[(u64)j * quadtree->map_length + i];
+				node.min_height = height < node.min_height ? height : node.min_height;
+				node.max_height = height > node.max_height ? height : node.max_height;
+			}
+		}
+	} else {
+		const u32 half = size / 2;
+
+		for (u32 quadrant = 0; quadrant < 4; quadrant++) {
+			const u32 child_x = x + (quadrant & 1) * half;
+			const u32 child_z = z + (quadrant >> 1) * half;
+
+			if (child_x >= world_length || child_z >= world_length) {
+				continue;
+			}
+
+			const u32 child = build_quadtree_node(quadtree, child_x, child_z, level - 1);
+			node.children[quadrant] = child;
+
+			const QuadtreeNode *child_node = &quadtree->nodes[child];
+			node.min_height = child_node->min_height < node.min_height ? child_node->min_height : node.min_height;
+			node.max_height = child_node->max_height > node.max_height ? child_node->max_height : node.max_height;
+		}
+	}
+
+	quadtree->nodes[index] = node;
+
+	return index;
+}
+
+void build_quadtree(const World *world, TerrainQuadtree *quadtree)
+{
+	const u32 world_length = world->world_tile_length;
+
+	quadtree->map_length = world_length + 1;
+	quadtree->levels = 1;
+
+	while (quadtree->levels < QUADTREE_MAX_LEVELS && ((u32)QUADTREE_GRID_TILES << (quadtree->levels - 1)) < world_length) {
+		quadtree->levels++;
+	}
+
+	build_quadtree_grid(quadtree);
+	gather_quadtree_maps(world, quadtree);
+
+	job_parallel_for(world->jobs, quadtree->levels, [quadtree](u32 level) {
+		quadtree->level_errors[level] = level > 0 ? measure_quadtree_level_error(quadtree, level) : 0.f;
+	});
+
+	// A coarser level never looks better than a finer one.
+	for (u32 level = 1; level < quadtree->levels; level++) {
+		if (quadtree->level_errors[level] < quadtree->level_errors[level - 1]) {
+			quadtree->level_errors[level] = quadtree->level_errors[level - 1];
+		}
+	}
+
+	quadtree->nodes.clear();
+	build_quadtree_node(quadtree, 0, 0, quadtree->levels - 1);
+}
+
+void quadtree_update_ranges(TerrainQuadtree *quadtree, real32 pixels_per_unit, real32 max_pixel_error)
+{
+	real32 previous_range = 0;
+
+	for (u32 level = 0; level < quadtree->levels; level++) {
+		real32 range = FLT_MAX;
+
+		// The root covers everything left over and never morphs.
+		if (level + 1 == quadtree->levels) {
+			quadtree->ranges[level] = FLT_MAX;
+			quadtree->morph_starts[level] = FLT_MAX;
+			break;
+		}
+
+		// Past this the next level's error is within the tolerance.
+		if (max_pixel_error > 0) {
+			range = quadtree->level_errors[level + 1] * pixels_per_unit / max_pixel_error;
+		}
+
+		// Each level's band has to be wider than its nodes so neighbouring
+		// nodes are never more than a level apart and morphing finishes
+		// before the next level is drawn.
+		const real32 min_range = level == 0 ? 3.f * QUADTREE_GRID_TILES : 2.f * previous_range;
+		range = range > min_range ? range : min_range;
+
+		quadtree->ranges[level] = range;
+		quadtree->morph_starts[level] = previous_range + (range - previous_range) * QUADTREE_MORPH_START;
+
+		previous_range = range;
+	}
+}
+
+struct QuadtreeSelection {
+    const TerrainQuadtree *quadtree;
+    V3 camera_pos;
+    const Frustum *frustum;
+    std::vector<QuadtreeDraw> *draws;
+    u32 culled;
+};
+
+static void quadtree_node_bounds(const TerrainQuadtree *quadtree, const QuadtreeNode *node, V3 *min, V3 *max)
+{
+	const u32 world_length = quadtree->map_length - 1;
+
+	*min = { (real32)node->x, node->min_height, (real32)node->z };
+	*max = {
+		(real32)(node->x + node->size < world_length ? node->x + node->size : world_length),
+		node->max_height,
+		(real32)(node->z + node->size < world_length ? node->z + node->size : world_length)
+	};
+}
+
+static bool32 quadtree_node_in_range(const QuadtreeSelection *selection, const QuadtreeNode *node, real32 range)
+{
+	V3 min, max;
+	quadtree_node_bounds(selection->quadtree, node, &min, &max);
+
+	const V3 pos = selection->camera_pos;
+	const real32 dx = pos.x < min.x ? min.x - pos.x : (pos.x > max.x ? pos.x - max.x : 0.f);
+	const real32 dy = pos.y < min.y ? min.y - pos.y : (pos.y > max.y ? pos.y - max.y : 0.f);
+	const real32 dz = pos.z < min.z ? min.z - pos.z : (pos.z > max.z ? pos.z - max.z : 0.f);
+
+	return range == FLT_MAX || dx * dx + dy * dy + dz * dz <= range * range;
+}
+
+// Returns false when the node is out of its level's range, leaving its area
+// to the parent.
+static bool32 quadtree_select_node(QuadtreeSelection *selection, u32 node_index)
+{
+	const TerrainQuadtree *quadtree = selection->quadtree;
+	const QuadtreeNode *node = &quadtree->nodes[node_index];
+
+	if (!quadtree_node_in_range(selection, node, quadtree->ranges[node->level])) {
+		return false;
+	}
+
+	// Handled, there's just nothing to see.
+	if (selection->frustum) {
+		V3 min, max;
+		quadtree_node_bounds(quadtree, node, &min, &max);
+
+		if (!frustum_test_box(selection->frustum, min, max)) {
+			selection->culled++;
+			return true;
+		}
+	}
+
+	if (node->level == 0 || !quadtree_node_in_range(selection, node, quadtree->ranges[node->level - 1])) {
+		selection->draws->push_back({ node_index, QUADTREE_QUADRANT_ALL });
+		return true;
+	}
+
+	// Children out of their range are drawn as this node's quadrants.
+	for (u32 quadrant = 0; quadrant < 4; quadrant++) {
+		if (node->children[quadrant] && !quadtree_select_node(selection, node->children[quadrant])) {
+			selection->draws->push_back({ node_index, (QuadtreeQuadrant)quadrant });
+		}
+	}
+
+	return true;
+}
+
+u32 quadtree_select(const TerrainQuadtree *quadtree, V3 camera_pos, const Frustum *frustum, std::vector<QuadtreeDraw> *draws)
+{
+	draws->clear();
+
+	if (quadtree->nodes.empty()) {
+		return 0;
+	}
+
+	QuadtreeSelection selection = {};
+	selection.quadtree = quadtree;
+	selection.camera_pos = camera_pos;
+	selection.frustum = frustum;
+	selection.draws = draws;
+
+	quadtree_select_node(&selection, 0);
+
+	return selection.culled;
+}
+
+u32 quadtree_draw_triangles(const TerrainQuadtree *quadtree, const QuadtreeDraw *draw)
+{
+	return quadtree->grid_ranges[draw->quadrant].count / 3;
+}
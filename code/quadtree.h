@@ -0,0 +1,89 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <vector>
+
+#include "types.h"
+#include "maths.h"
+#include "world.h"
+#include "frustum.h"
+
+// Tiles along a side of the grid mesh every node is drawn with. A node at
+// level l covers QUADTREE_GRID_TILES << l tiles, stepping 1 << l at a time.
+#define QUADTREE_GRID_TILES 32
+#define QUADTREE_MAX_LEVELS 16
+
+// How far through its range a level starts morphing into the next.
+#define QUADTREE_MORPH_START 0.7f
+
+// The grid mesh ranges, one per quadrant of a node and the whole node.
+enum QuadtreeQuadrant {
+    QUADTREE_QUADRANT_BOTTOM_LEFT, // Smallest x and z.
+    QUADTREE_QUADRANT_BOTTOM_RIGHT,
+    QUADTREE_QUADRANT_TOP_LEFT,
+    QUADTREE_QUADRANT_TOP_RIGHT,
+    QUADTREE_QUADRANT_ALL,
+    QUADTREE_QUADRANT_COUNT
+};
+
+struct QuadtreeNode {
+    u32 x, z; // Corner in world tiles.
+    u32 size; // Tiles along a side, may reach past the world's edge.
+    u32 level; // 0 is full detail.
+    real32 min_height, max_height;
+    u32 children[4]; // By quadrant, 0 where a quadrant lies outside the world.
+};
+
+// A node, or one quadrant of it, to draw with the grid mesh.
+struct QuadtreeDraw {
+    u32 node;
+    QuadtreeQuadrant quadrant;
+};
+
+// CDLOD style terrain for large worlds. The whole world's heights and normals
+// are gathered from the chunks into one map and drawn by a single grid mesh,
+// placed and scaled per node. Nodes are picked by distance and frustum so the
+// cost follows the view rather than the world size, and vertices morph into
+// the next level before it takes over so levels meet without cracks.
+struct TerrainQuadtree {
+    std::vector<QuadtreeNode> nodes; // The root first.
+    u32 levels;
+
+    // Largest height error of each level's grid against full detail.
+    real32 level_errors[QUADTREE_MAX_LEVELS];
+
+    // A node at a level is drawn within ranges[level] of the camera and splits
+    // into its children within ranges[level - 1]. Its vertices morph between
+    // morph_starts[level] and ranges[level].
+    real32 ranges[QUADTREE_MAX_LEVELS];
+    real32 morph_starts[QUADTREE_MAX_LEVELS];
+
+    // (world_tile_length + 1)^2 heights and octahedral normals.
+    std::vector<real32> heights;
+    std::vector<s16> normals;
+    u32 map_length;
+
+    // The shared grid mesh, (QUADTREE_GRID_TILES + 1)^2 vertices.
+    std::vector<u16> grid_indices;
+    IndexRange grid_ranges[QUADTREE_QUADRANT_COUNT];
+
+    u32 grid_vbo, grid_ebo;
+    u32 height_texture, normal_texture;
+};
+
+// Gathers the heights from the world's chunks and builds the nodes and level
+// errors, run again after the terrain is generated.
+extern void build_quadtree(const World *world, TerrainQuadtree *quadtree);
+
+// Sets the ranges so each level is used where its error stays within
+// max_pixel_error, for a camera with pixels_per_unit pixels per unit of height
+// at a distance of 1.
+extern void quadtree_update_ranges(TerrainQuadtree *quadtree, real32 pixels_per_unit, real32 max_pixel_error);
+
+// Selects what to draw for a camera. Nodes outside frustum are left out, it
+// may be null to keep everything in range. Returns how many nodes it culled.
+extern u32 quadtree_select(const TerrainQuadtree *quadtree, V3 camera_pos, const Frustum *frustum, std::vector<QuadtreeDraw> *draws);
+
+extern u32 quadtree_draw_triangles(const TerrainQuadtree *quadtree, const QuadtreeDraw *draw);
+
+#endif
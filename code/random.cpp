@@ -0,0 +1,45 @@
+#include "random.h"
+
+// The SplitMix64 finaliser. Successive counters times the golden ratio step
+// through every 64-bit value, and this scatters them.
+static u64 random_mix(u64 x)
+{
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+#define RANDOM_GOLDEN_GAMMA 0x9E3779B97F4A7C15ull
+
+RandomStream random_stream(u32 seed, RandomSubsystem subsystem, u32 x, u32 y)
+{
+	const u64 chunk = ((u64)y << 32) | x;
+
+	RandomStream stream;
+	stream.key = random_mix(random_mix(random_mix(seed + RANDOM_GOLDEN_GAMMA) ^ subsystem) ^ chunk);
+	stream.counter = 0;
+
+	return stream;
+}
+
+u32 random_u32(RandomStream *stream)
+{
+	return (u32)(random_mix(stream->key + ++stream->counter * RANDOM_GOLDEN_GAMMA) >> 32);
+}
+
+u32 random_below(RandomStream *stream, u32 bound)
+{
+	// Scaled rather than taken modulo, the bias is at most bound / 2^32.
+	return (u32)(((u64)random_u32(stream) * bound) >> 32);
+}
+
+real32 random_unit(RandomStream *stream)
+{
+	// The top 24 bits fill a float's mantissa exactly.
+	return (random_u32(stream) >> 8) * (1.f / 16777216.f);
+}
+
+real32 random_range(RandomStream *stream, real32 min, real32 max)
+{
+	return min + random_unit(stream) * (max - min);
+}
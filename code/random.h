@@ -0,0 +1,35 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include "types.h"
+
+// Counter based random numbers. The n-th number of a stream is a hash of the
+// stream's key and n, so a stream needs no state besides its position and
+// the numbers a chunk draws don't depend on which thread draws them or on
+// what any other chunk drew before it.
+struct RandomStream {
+    u64 key;
+    u64 counter; // Numbers drawn so far, the index of the next one.
+};
+
+// What the numbers decide. Each has its own streams so drawing more for one
+// never moves another.
+enum RandomSubsystem {
+    RANDOM_NOISE,
+    RANDOM_TREES,
+    RANDOM_ROCKS,
+    RANDOM_SUBSYSTEM_COUNT
+};
+
+// The stream of a subsystem in the chunk at x, y for a world seed. Things
+// that belong to no chunk use chunk 0, 0.
+extern RandomStream random_stream(u32 seed, RandomSubsystem subsystem, u32 x, u32 y);
+
+extern u32 random_u32(RandomStream *stream);
+// In [0, bound), bound must not be 0.
+extern u32 random_below(RandomStream *stream, u32 bound);
+// In [0, 1).
+extern real32 random_unit(RandomStream *stream);
+extern real32 random_range(RandomStream *stream, real32 min, real32 max);
+
+#endif
@@ -5,8 +5,8 @@ namespace Shaders {
     const char *const DEFAULT_VERTEX_SHADER_SOURCE = R"(
     #version 330
 
-    layout (location = 0) in vec3 a_pos;
-    layout (location = 1) in vec3 a_nor;
+    layout (location = 0) in float a_height;
+    layout (location = 1) in vec2 a_nor_oct;
 
     out vec3 v_pos;
     out vec3 v_nor;
@@ -16,15 +16,28 @@ namespace Shaders {
     uniform mat4 view;
     uniform mat4 model;
     uniform mat4 light_space_matrix;
+    uniform int vertices_length;
     
     uniform vec4 plane; 
 
+    // Octahedral normal folded around y, matches v3_oct_decode.
+    vec3 oct_decode(vec2 e)
+    {
+        vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+        if (n.y < 0.0) {
+            n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+        }
+        return normalize(n);
+    }
+
     void main()
     {
+        // Chunk vertices only store the height, x and z come from the grid index.
+        vec3 a_pos = vec3(gl_VertexID % vertices_length, a_height, gl_VertexID / vertices_length);
         vec4 world_position = model * vec4(a_pos, 1.0);
 
         v_pos = vec3(world_position);
-        v_nor = a_nor;
+        v_nor = oct_decode(a_nor_oct);
         frag_pos_light_space = light_space_matrix * world_position;
 
         gl_ClipDistance[0] = dot(world_position, plane);
@@ -130,11 +143,84 @@ namespace Shaders {
     }
     )";
 
+    const char *const QUADTREE_VERTEX_SHADER_SOURCE = R"(
+    #version 330
+
+    layout (location = 0) in vec2 a_grid;
+
+    out vec3 v_pos;
+    out vec3 v_nor;
+    out vec4 frag_pos_light_space;
+
+    uniform mat4 projection;
+    uniform mat4 view;
+    uniform mat4 light_space_matrix;
+
+    uniform vec4 plane;
+
+    uniform vec4 node; // Corner x and z in tiles, then tiles per grid step.
+    uniform vec2 morph; // Distance the morph starts at, 1 / its length.
+    uniform float world_length;
+    uniform vec3 view_position;
+
+    uniform sampler2D height_map;
+    uniform sampler2D normal_map;
+
+    // Octahedral normal folded around y, matches v3_oct_decode.
+    vec3 oct_decode(vec2 e)
+    {
+        vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+        if (n.y < 0.0) {
+            n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+        }
+        return normalize(n);
+    }
+
+    // The grid vertex placed in the node, clamped to the world's far edge so
+    // nodes reaching past it fold their last row and column onto the edge.
+    vec2 node_position(vec2 grid)
+    {
+        return min(node.xy + grid * node.z, vec2(world_length));
+    }
+
+    float height_at(vec2 position)
+    {
+        return texture(height_map, (position + 0.5) / vec2(textureSize(height_map, 0))).r;
+    }
+
+    // Odd grid vertices slide onto their even neighbours as the camera moves
+    // away, so by the end of the node's range it matches the next level.
+    vec2 morph_position()
+    {
+        vec2 position = node_position(a_grid);
+        float distance_to_camera = distance(view_position, vec3(position.x, height_at(position), position.y));
+        float k = clamp((distance_to_camera - morph.x) * morph.y, 0.0, 1.0);
+        return node_position(a_grid - mod(a_grid, 2.0) * k);
+    }
+
+    void main()
+    {
+        vec2 position = morph_position();
+        vec4 world_position = vec4(position.x, height_at(position), position.y, 1.0);
+
+        v_pos = vec3(world_position);
+        v_nor = oct_decode(texture(normal_map, (position + 0.5) / vec2(textureSize(normal_map, 0))).rg);
+        frag_pos_light_space = light_space_matrix * world_position;
+
+        gl_ClipDistance[0] = dot(world_position, plane);
+
+        gl_Position = projection * view * world_position;
+    }
+    )";
+
     const char *const SIMPLE_VERTEX_SHADER_SOURCE = R"(
     #version 330
 
     layout (location = 0) in vec3 a_pos;
     layout (location = 1) in vec3 a_nor;
+    layout (location = 2) in vec4 a_model_row0;
+    layout (location = 3) in vec4 a_model_row1;
+    layout (location = 4) in vec4 a_model_row2;
 
     out vec3 v_pos;
     out vec3 v_nor;
@@ -142,13 +228,15 @@ namespace Shaders {
 
     uniform mat4 projection;
     uniform mat4 view;
-    uniform mat4 model;
+    uniform float instance_scale;
     uniform mat4 light_space_matrix;
     
     void main()
     {
-        vec4 world_position = model * vec4(a_pos, 1.f);
-        vec4 world_normal = model * vec4(a_nor, 0.f);
+        // The instance's rows, scaled by the feature's size.
+        mat4 model = transpose(mat4(a_model_row0, a_model_row1, a_model_row2, vec4(0.0, 0.0, 0.0, 1.0)));
+        vec4 world_position = model * vec4(a_pos * instance_scale, 1.f);
+        vec4 world_normal = model * vec4(a_nor * instance_scale, 0.f);
 
         v_pos = vec3(world_position);
         v_nor = vec3(world_normal);
@@ -280,13 +368,34 @@ namespace Shaders {
     #version 330
 
     layout (location = 0) in vec3 a_pos;
+    layout (location = 2) in vec4 a_model_row0;
+    layout (location = 3) in vec4 a_model_row1;
+    layout (location = 4) in vec4 a_model_row2;
+
+    uniform mat4 projection;
+    uniform mat4 view;
+    uniform float instance_scale;
+
+    void main()
+    {
+        mat4 model = transpose(mat4(a_model_row0, a_model_row1, a_model_row2, vec4(0.0, 0.0, 0.0, 1.0)));
+        gl_Position = projection * view * model * vec4(a_pos * instance_scale, 1.0);
+    }
+    )";
+
+    const char *const TERRAIN_DEPTH_VERTEX_SHADER_SOURCE = R"(
+    #version 330
+
+    layout (location = 0) in float a_height;
 
     uniform mat4 projection;
     uniform mat4 view;
     uniform mat4 model;
+    uniform int vertices_length;
 
     void main()
     {
+        vec3 a_pos = vec3(gl_VertexID % vertices_length, a_height, gl_VertexID / vertices_length);
         gl_Position = projection * view * model * vec4(a_pos, 1.0);
     }
     )";
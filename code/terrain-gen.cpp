@@ -0,0 +1,345 @@
+// Headless world generator. Reads .world presets, generates the worlds and
+// exports them as OBJ without needing a window or a GPU. Several presets are
+// generated side by side, each world has its own noise context.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "types.h"
+#include "world.h"
+#include "export.h"
+#include "object.h"
+#include "perlin.h"
+#include "quadtree.h"
+
+struct GenerateOptions {
+	std::string output_directory;
+	std::string data_directory;
+	u32 lods;
+	bool32 memory_report;
+	bool32 quadtree_report;
+	bool32 export_enabled;
+	ExportSettings export_settings;
+};
+
+// Output from one preset, printed once it's done so runs don't interleave.
+struct GenerateResult {
+	std::string log;
+	bool32 ok;
+};
+
+static void print_usage(const char *program)
+{
+	printf("usage: %s <preset.world>... [options]\n", program);
+	printf("  -o <dir>            output directory (default ./export)\n");
+	printf("  --data <dir>        directory with trunk.obj, leaves.obj and rock.obj (default ./data)\n");
+	printf("  --lods <n>          number of LODs to generate and export (default 1)\n");
+	printf("  --normals           include vertex normals\n");
+	printf("  --separate-chunks   one OBJ file per chunk\n");
+	printf("  --trees             export trees\n");
+	printf("  --rocks             export rocks\n");
+	printf("  --threads <n>       threads to generate with (default one per core)\n");
+	printf("  --noise <kernel>    scalar, sse4.1, avx2 or avx512 (default best supported)\n");
+	printf("  --memory            break the memory use down per chunk and LOD, with vertex cache misses\n");
+	printf("  --quadtree          build the quadtree terrain and report what a camera over the middle selects\n");
+	printf("  --no-export         generate only\n");
+}
+
+static real64 elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<real64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void log_printf(GenerateResult *result, const char *format, ...)
+{
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	result->log += buffer;
+}
+
+static real64 mebibytes(u64 bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+static void log_memory_report(GenerateResult *result, const World *world, bool32 detailed)
+{
+	WorldMemoryReport report;
+	world_memory_report(world, &report);
+
+	log_printf(result, "  memory: %.2f MiB (terrain %.2f, field %.2f, features %.2f)\n",
+		mebibytes(report.total), mebibytes(report.terrain), mebibytes(report.field), mebibytes(report.features));
+
+	if (detailed) {
+		log_printf(result, "    per chunk: %llu bytes (vertices %llu)\n",
+			(unsigned long long)report.chunk_total, (unsigned long long)report.chunk_vertices);
+		log_printf(result, "    LOD indices: %llu bytes shared by all chunks\n", (unsigned long long)report.lods);
+
+		for (u32 lod = 0; lod < world->lod_settings.max_available_count; lod++) {
+			const LODDataInfo *info = &world->lod_settings.data_infos[lod];
+			log_printf(result, "    LOD %u: %llu bytes, ACMR %.3f (row-major %.3f)\n", lod, (unsigned long long)report.lod_indices[lod], info->acmr, info->acmr_unordered);
+		}
+	}
+}
+
+static void log_quadtree_selection(GenerateResult *result, const char *name, const TerrainQuadtree *quadtree, const std::vector<QuadtreeDraw> *draws)
+{
+	u32 level_draws[QUADTREE_MAX_LEVELS] = {};
+	u64 triangles = 0;
+
+	for (const QuadtreeDraw &draw : *draws) {
+		level_draws[quadtree->nodes[draw.node].level]++;
+		triangles += quadtree_draw_triangles(quadtree, &draw);
+	}
+
+	log_printf(result, "    %s: %zu draws, %llu triangles, per level", name, draws->size(), (unsigned long long)triangles);
+
+	for (u32 level = 0; level < quadtree->levels; level++) {
+		log_printf(result, " %u", level_draws[level]);
+	}
+
+	log_printf(result, "\n");
+}
+
+// Selects for a 1920x1080 camera with a 60 degree fov, a little above the
+// middle of the world and looking along x, with and without its frustum.
+static void log_quadtree_report(GenerateResult *result, const World *world)
+{
+	TerrainQuadtree *quadtree = new TerrainQuadtree();
+
+	auto stage = std::chrono::steady_clock::now();
+	build_quadtree(world, quadtree);
+	log_printf(result, "  quadtree: %.2f ms (%u levels, %zu nodes)\n", elapsed_ms(stage), quadtree->levels, quadtree->nodes.size());
+
+	const real32 fov_y = radians(60.f);
+	const real32 width = 1920.f, height = 1080.f;
+	quadtree_update_ranges(quadtree, height / (2.f * tanf(fov_y / 2.f)), world->lod_settings.max_pixel_error);
+
+	// The root's range is unbounded.
+	for (u32 level = 0; level + 1 < quadtree->levels; level++) {
+		log_printf(result, "    level %u: error %.3f, range %.1f\n", level, quadtree->level_errors[level], quadtree->ranges[level]);
+	}
+
+	const QuadtreeNode *root = &quadtree->nodes[0];
+	const real32 middle = world->world_tile_length / 2.f;
+	const V3 camera_pos = { middle, root->max_height + 10.f, middle };
+
+	real32 projection[16], view[16], view_projection[16];
+	Frustum frustum;
+	const real32 top = .05f * tanf(fov_y / 2.f);
+	mat4_frustrum(projection, -top * width / height, top * width / height, -top, top, .05f, 10000.f);
+	mat4_look_at(view, camera_pos, camera_pos + V3{ 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+	mat4_multiply(view_projection, projection, view);
+	frustum_from_matrix(&frustum, view_projection);
+
+	std::vector<QuadtreeDraw> draws;
+
+	quadtree_select(quadtree, camera_pos, 0, &draws);
+	log_quadtree_selection(result, "all around", quadtree, &draws);
+
+	quadtree_select(quadtree, camera_pos, &frustum, &draws);
+	log_quadtree_selection(result, "in frustum", quadtree, &draws);
+
+	log_printf(result, "    chunks at LOD 0: %llu triangles\n", (unsigned long long)world->lod_settings.data_infos[0].triangles_count * world->world_area);
+
+	std::vector<u8> chunks_visible(world->chunk_boxes.count);
+	const u32 chunks_in_frustum = frustum_cull_boxes(&frustum, &world->chunk_boxes, chunks_visible.data());
+	log_printf(result, "    chunks in frustum: %u of %u\n", chunks_in_frustum, world->chunk_boxes.count);
+
+	delete quadtree;
+}
+
+static void generate_preset(const char *preset_filename, const GenerateOptions *options, JobSystem *jobs, GenerateResult *result)
+{
+	preset_file preset = {};
+	preset.name = std::filesystem::path(preset_filename).stem().string();
+
+	if (!load_preset_file(preset_filename, &preset)) {
+		log_printf(result, "Failed to read preset %s\n", preset_filename);
+		return;
+	}
+
+	if (preset.params.world_width < 1 || preset.params.chunk_tile_length < 1) {
+		log_printf(result, "Preset %s has an empty world\n", preset_filename);
+		return;
+	}
+
+	World *world = new World();
+	world->params = &preset.params;
+	world->jobs = jobs;
+
+	auto start = std::chrono::steady_clock::now();
+
+	init_terrain(world, preset.params.chunk_tile_length, preset.params.world_width);
+
+	u32 lods = options->lods;
+	if (lods > world->lod_settings.max_available_count) {
+		lods = world->lod_settings.max_available_count;
+	}
+
+	world->lod_settings.details_in_use = lods > 0 ? lods : 1;
+
+	seed_perlin(&world->noise, preset.params.seed);
+
+	log_printf(result, "Generating '%s': %ux%u chunks of %u tiles\n", preset.name.c_str(), preset.params.world_width, preset.params.world_width, preset.params.chunk_tile_length);
+	log_memory_report(result, world, options->memory_report);
+
+	auto stage = std::chrono::steady_clock::now();
+	generate_terrain_chunks(world);
+	log_printf(result, "  terrain: %.2f ms\n", elapsed_ms(stage));
+
+	if (options->quadtree_report) {
+		log_quadtree_report(result, world);
+	}
+
+	stage = std::chrono::steady_clock::now();
+	generate_trees(world);
+	generate_rocks(world);
+	log_printf(result, "  features: %.2f ms (%u of %u trees, %u of %u rocks)\n", elapsed_ms(stage), world->trees.count, preset.params.tree_count, world->rocks.count, preset.params.rock_count);
+
+	if (options->export_enabled) {
+		ExportSettings export_settings = options->export_settings;
+
+		Object *trunk = 0;
+		Object *leaves = 0;
+		Object *rock = 0;
+
+		if (export_settings.trees) {
+			trunk = load_object((options->data_directory + "/trunk.obj").c_str());
+			leaves = load_object((options->data_directory + "/leaves.obj").c_str());
+		}
+
+		if (export_settings.rocks) {
+			rock = load_object((options->data_directory + "/rock.obj").c_str());
+		}
+
+		stage = std::chrono::steady_clock::now();
+		const std::string path = export_create_directory(options->output_directory, preset.name);
+		export_world(world, &export_settings, trunk, leaves, rock, path);
+		log_printf(result, "  export: %.2f ms -> %s\n", elapsed_ms(stage), path.c_str());
+
+		free_object(trunk);
+		free_object(leaves);
+		free_object(rock);
+	}
+
+	log_printf(result, "  total: %.2f ms\n", elapsed_ms(start));
+
+	// Presets run side by side, only the one being generated stays resident.
+	free_world(world);
+	delete world;
+
+	result->ok = true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<const char *> preset_filenames;
+	u32 threads = 0;
+
+	GenerateOptions options = {};
+	options.output_directory = "./export";
+	options.data_directory = "./data";
+	options.lods = 1;
+	options.export_enabled = true;
+
+	for (s32 i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+
+		if (!strcmp(arg, "-o") && i + 1 < argc) {
+			options.output_directory = argv[++i];
+		} else if (!strcmp(arg, "--data") && i + 1 < argc) {
+			options.data_directory = argv[++i];
+		} else if (!strcmp(arg, "--lods") && i + 1 < argc) {
+			options.lods = (u32)atoi(argv[++i]);
+			options.export_settings.lods = true;
+		} else if (!strcmp(arg, "--threads") && i + 1 < argc) {
+			threads = (u32)atoi(argv[++i]);
+		} else if (!strcmp(arg, "--noise") && i + 1 < argc) {
+			const char *name = argv[++i];
+			s32 kernel = PERLIN_KERNEL_COUNT;
+
+			for (s32 k = 0; k < PERLIN_KERNEL_COUNT; k++) {
+				if (!strcmp(name, perlin_kernel_name((PerlinKernel)k))) {
+					kernel = k;
+				}
+			}
+
+			if (!perlin_set_kernel((PerlinKernel)kernel)) {
+				fprintf(stderr, "Noise kernel %s is not supported here\n", name);
+				return 1;
+			}
+		} else if (!strcmp(arg, "--normals")) {
+			options.export_settings.with_normals = true;
+		} else if (!strcmp(arg, "--separate-chunks")) {
+			options.export_settings.seperate_chunks = true;
+		} else if (!strcmp(arg, "--trees")) {
+			options.export_settings.trees = true;
+		} else if (!strcmp(arg, "--rocks")) {
+			options.export_settings.rocks = true;
+		} else if (!strcmp(arg, "--memory")) {
+			options.memory_report = true;
+		} else if (!strcmp(arg, "--quadtree")) {
+			options.quadtree_report = true;
+		} else if (!strcmp(arg, "--no-export")) {
+			options.export_enabled = false;
+		} else if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+			print_usage(argv[0]);
+			return 0;
+		} else if (arg[0] != '-') {
+			preset_filenames.push_back(arg);
+		} else {
+			fprintf(stderr, "Unknown argument: %s\n", arg);
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (preset_filenames.empty()) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	JobSystem *jobs = new JobSystem();
+	job_system_init(jobs, threads > 0 ? threads - 1 : JOB_WORKERS_AUTO);
+
+	printf("%zu preset(s) on %u threads, %s noise\n", preset_filenames.size(), job_system_thread_count(jobs), perlin_kernel_name(perlin_get_kernel()));
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<GenerateResult> results(preset_filenames.size());
+
+	// Each preset is a job and fans its chunks out on the same pool.
+	job_parallel_for(jobs, preset_filenames.size(), [&](u32 index) {
+		generate_preset(preset_filenames[index], &options, jobs, &results[index]);
+	});
+
+	s32 failed = 0;
+	for (auto &result : results) {
+		fputs(result.log.c_str(), result.ok ? stdout : stderr);
+		failed += result.ok ? 0 : 1;
+	}
+
+	printf("Total: %.2f ms\n", elapsed_ms(start));
+
+	job_system_shutdown(jobs);
+	delete jobs;
+
+	return failed > 0 ? 1 : 0;
+}
@@ -17,6 +17,8 @@ typedef int32_t bool32;
 typedef float real32;
 typedef double real64;
 
+#ifndef M_PI
 #define M_PI 3.14159265359
+#endif
 
 #endif
\ No newline at end of file
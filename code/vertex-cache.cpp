@@ -0,0 +1,199 @@
+#include "vertex-cache.h"
+
+#include <math.h>
+#include <vector>
+
+// Scoring from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+static const real32 CACHE_DECAY_POWER = 1.5f;
+static const real32 LAST_TRIANGLE_SCORE = 0.75f;
+static const real32 VALENCE_BOOST_SCALE = 2.f;
+static const real32 VALENCE_BOOST_POWER = 0.5f;
+
+struct CacheVertex {
+	s32 cache_position; // -1 when not in the cache.
+	u32 triangles_left; // Triangles using the vertex that haven't been emitted.
+	u32 triangles_offset; // Start of the vertex's triangles in the adjacency list.
+	real32 score;
+};
+
+static real32 vertex_score(const CacheVertex *vertex)
+{
+	if (vertex->triangles_left == 0) {
+		return -1.f;
+	}
+
+	real32 score = 0.f;
+
+	if (vertex->cache_position >= 0) {
+		if (vertex->cache_position < 3) {
+			// The last triangle's vertices score a fixed amount so the next
+			// triangle doesn't just continue a strip.
+			score = LAST_TRIANGLE_SCORE;
+		} else {
+			const real32 scaler = 1.f / (VERTEX_CACHE_SIZE - 3);
+			score = powf(1.f - (vertex->cache_position - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	// Favour vertices with few triangles left so they don't get stranded.
+	score += VALENCE_BOOST_SCALE * powf((real32)vertex->triangles_left, -VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void vertex_cache_optimise(u32 *indices, u64 indices_count, u32 vertices_count)
+{
+	const u64 triangles_count = indices_count / 3;
+
+	if (triangles_count == 0) {
+		return;
+	}
+
+	std::vector<CacheVertex> vertices(vertices_count);
+
+	for (u64 i = 0; i < indices_count; i++) {
+		vertices[indices[i]].triangles_left++;
+	}
+
+	u32 offset = 0;
+	for (auto &vertex : vertices) {
+		vertex.cache_position = -1;
+		vertex.triangles_offset = offset;
+		offset += vertex.triangles_left;
+	}
+
+	// Triangles using each vertex, emitted ones are swapped past triangles_left.
+	std::vector<u32> adjacency(indices_count);
+	std::vector<u32> adjacency_filled(vertices_count);
+
+	for (u64 triangle = 0; triangle < triangles_count; triangle++) {
+		for (u32 corner = 0; corner < 3; corner++) {
+			const u32 v = indices[triangle * 3 + corner];
+			adjacency[vertices[v].triangles_offset + adjacency_filled[v]++] = (u32)triangle;
+		}
+	}
+
+	for (auto &vertex : vertices) {
+		vertex.score = vertex_score(&vertex);
+	}
+
+	std::vector<u8> emitted(triangles_count);
+	std::vector<u32> output(indices_count);
+
+	u32 cache[VERTEX_CACHE_SIZE + 3];
+	u32 cache_count = 0;
+
+	s64 best_triangle = -1;
+	u64 next_unemitted = 0;
+
+	for (u64 out = 0; out < triangles_count; out++) {
+		// Nothing in the cache has triangles left, start again from the first
+		// triangle that hasn't been emitted.
+		if (best_triangle < 0) {
+			while (emitted[next_unemitted]) {
+				next_unemitted++;
+			}
+
+			best_triangle = next_unemitted;
+		}
+
+		const u32 *triangle_indices = &indices[best_triangle * 3];
+		emitted[best_triangle] = true;
+
+		for (u32 corner = 0; corner < 3; corner++) {
+			const u32 v = triangle_indices[corner];
+			output[out * 3 + corner] = v;
+
+			CacheVertex *vertex = &vertices[v];
+			u32 *triangles = &adjacency[vertex->triangles_offset];
+
+			for (u32 i = 0; i < vertex->triangles_left; i++) {
+				if (triangles[i] == best_triangle) {
+					triangles[i] = triangles[vertex->triangles_left - 1];
+					triangles[vertex->triangles_left - 1] = (u32)best_triangle;
+					break;
+				}
+			}
+
+			vertex->triangles_left--;
+		}
+
+		// The triangle's vertices go to the front of the LRU cache.
+		u32 new_cache[VERTEX_CACHE_SIZE + 3];
+		u32 new_cache_count = 0;
+
+		for (u32 corner = 0; corner < 3; corner++) {
+			new_cache[new_cache_count++] = triangle_indices[corner];
+		}
+
+		for (u32 i = 0; i < cache_count; i++) {
+			const u32 v = cache[i];
+
+			if (v != triangle_indices[0] && v != triangle_indices[1] && v != triangle_indices[2]) {
+				new_cache[new_cache_count++] = v;
+			}
+		}
+
+		for (u32 i = 0; i < new_cache_count; i++) {
+			CacheVertex *vertex = &vertices[new_cache[i]];
+			vertex->cache_position = i < VERTEX_CACHE_SIZE ? (s32)i : -1;
+			vertex->score = vertex_score(vertex);
+		}
+
+		// Rescore the triangles touching the cache and pick the best for next.
+		best_triangle = -1;
+		real32 best_score = -1.f;
+
+		for (u32 i = 0; i < new_cache_count; i++) {
+			const CacheVertex *vertex = &vertices[new_cache[i]];
+			const u32 *triangles = &adjacency[vertex->triangles_offset];
+
+			for (u32 t = 0; t < vertex->triangles_left; t++) {
+				const u32 triangle = triangles[t];
+
+				real32 score = 0.f;
+				for (u32 corner = 0; corner < 3; corner++) {
+					score += vertices[indices[triangle * 3 + corner]].score;
+				}
+
+				if (score > best_score) {
+					best_score = score;
+					best_triangle = triangle;
+				}
+			}
+		}
+
+		cache_count = new_cache_count < VERTEX_CACHE_SIZE ? new_cache_count : VERTEX_CACHE_SIZE;
+		for (u32 i = 0; i < cache_count; i++) {
+			cache[i] = new_cache[i];
+		}
+	}
+
+	for (u64 i = 0; i < indices_count; i++) {
+		indices[i] = output[i];
+	}
+}
+
+real32 vertex_cache_acmr(const u32 *indices, u64 indices_count, u32 vertices_count)
+{
+	const u64 triangles_count = indices_count / 3;
+
+	if (triangles_count == 0) {
+		return 0.f;
+	}
+
+	// A vertex is still cached if fewer than VERTEX_CACHE_SIZE misses have
+	// happened since it was loaded. 0 means it was never loaded.
+	std::vector<u64> loaded_at(vertices_count);
+	u64 misses = 0;
+
+	for (u64 i = 0; i < indices_count; i++) {
+		u64 *loaded = &loaded_at[indices[i]];
+
+		if (*loaded == 0 || misses - (*loaded - 1) >= VERTEX_CACHE_SIZE) {
+			*loaded = ++misses;
+		}
+	}
+
+	return (real32)misses / triangles_count;
+}
@@ -19,6 +19,8 @@ GLF(BindVertexArray, BINDVERTEXARRAY);\
 GLF(BufferData, BUFFERDATA);\
 GLF(VertexAttribPointer, VERTEXATTRIBPOINTER);\
 GLF(EnableVertexAttribArray, ENABLEVERTEXATTRIBARRAY);\
+GLF(DisableVertexAttribArray, DISABLEVERTEXATTRIBARRAY);\
+GLF(VertexAttribDivisor, VERTEXATTRIBDIVISOR);\
 GLF(CompileShader, COMPILESHADER);\
 GLF(ShaderSource, SHADERSOURCE);\
 GLF(AttachShader, ATTACHSHADER);\
@@ -41,9 +43,11 @@ GLF(Uniform4fv, UNIFORM4FV);\
 GLF(DebugMessageCallback, DEBUGMESSAGECALLBACK);\
 GLF(Uniform1i, UNIFORM1I);\
 GLF(Uniform1f, UNIFORM1F);\
+GLF(Uniform2f, UNIFORM2F);\
 GLF(BindSampler, BINDSAMPLER);\
 GLF(ActiveTexture, ACTIVETEXTURE);\
 GLF(DrawElementsBaseVertex, DRAWELEMENTSBASEVERTEX);\
+GLF(DrawElementsInstanced, DRAWELEMENTSINSTANCED);\
 GLF(BlendEquation, BLENDEQUATION);\
 GLF(BlendEquationSeparate, BLENDEQUATIONSEPARATE);\
 GLF(BlendFuncSeparate, BLENDFUNCSEPARATE);\
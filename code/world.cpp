@@ -0,0 +1,1124 @@
+#include "world.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+
+#include "perlin.h"
+#include "random.h"
+#include "vertex-cache.h"
+
+bool32 load_preset_file(const std::string &filename, preset_file *p_file)
+{
+	std::ifstream file(filename, std::ios::binary);
+
+	if (!file.good()) {
+		return false;
+	}
+
+	file.read((char *)&p_file->params, sizeof(world_generation_parameters));
+	file.close();
+
+	return true;
+}
+
+bool32 save_preset_file(const std::string &filename, preset_file *p_file)
+{
+	std::ofstream file(filename, std::ios::binary);
+
+	if (!file.good()) {
+		return false;
+	}
+
+	file.write((char *)&p_file->params, sizeof(world_generation_parameters));
+	file.close();
+
+	return true;
+}
+
+// Appends a triangle, wound clockwise in x/z like the rest of the terrain.
+static void push_lod_triangle(std::vector<u32> *indices, u32 chunk_vertices_length, u32 a, u32 b, u32 c)
+{
+	const s64 ax = a % chunk_vertices_length, az = a / chunk_vertices_length;
+	const s64 bx = b % chunk_vertices_length, bz = b / chunk_vertices_length;
+	const s64 cx = c % chunk_vertices_length, cz = c / chunk_vertices_length;
+
+	if ((bx - ax) * (cz - az) - (bz - az) * (cx - ax) > 0) {
+		u32 swap = b;
+		b = c;
+		c = swap;
+	}
+
+	indices->push_back(a);
+	indices->push_back(b);
+	indices->push_back(c);
+}
+
+// Vertex t along an edge and s in from it.
+static u32 lod_edge_vertex(LODEdge edge, u32 lod_length, u32 chunk_vertices_length, u32 t, u32 s)
+{
+	switch (edge) {
+		case LOD_EDGE_BOTTOM: return s * chunk_vertices_length + t;
+		case LOD_EDGE_RIGHT: return t * chunk_vertices_length + (lod_length - s);
+		case LOD_EDGE_TOP: return (lod_length - s) * chunk_vertices_length + t;
+		default: return t * chunk_vertices_length + s;
+	}
+}
+
+// Triangulates the strip between the chunk edge, with a vertex every
+// edge_detail, and the LOD's first inner row at detail. The four strips of a
+// LOD meet on the diagonals of its corner tiles.
+static void build_lod_edge(std::vector<u32> *indices, LODEdge edge, u32 lod_length, u32 chunk_vertices_length, u32 detail, u32 edge_detail)
+{
+	const u32 outer_count = lod_length / edge_detail;
+	const u32 inner_count = (lod_length - 2 * detail) / detail;
+
+	u32 outer = 0, inner = 0;
+
+	// Walk both rows, always stepping the one whose next vertex comes first.
+	while (outer < outer_count || inner < inner_count) {
+		const u32 outer_t = outer * edge_detail;
+		const u32 inner_t = detail + inner * detail;
+
+		const u32 a = lod_edge_vertex(edge, lod_length, chunk_vertices_length, outer_t, 0);
+		const u32 b = lod_edge_vertex(edge, lod_length, chunk_vertices_length, inner_t, detail);
+
+		if (inner == inner_count || (outer < outer_count && outer_t + edge_detail <= inner_t + detail)) {
+			push_lod_triangle(indices, chunk_vertices_length, a, b, lod_edge_vertex(edge, lod_length, chunk_vertices_length, outer_t + edge_detail, 0));
+			outer++;
+		} else {
+			push_lod_triangle(indices, chunk_vertices_length, a, b, lod_edge_vertex(edge, lod_length, chunk_vertices_length, inner_t + detail, detail));
+			inner++;
+		}
+	}
+}
+
+static IndexRange end_lod_range(const std::vector<u32> *indices, u64 offset)
+{
+	return { offset, (u32)(indices->size() - offset) };
+}
+
+// Every LOD's interior and edge strips back to back. They only depend on the
+// chunk size and the details so every chunk draws from the same indices.
+static void build_lod_indices(LODSettings *lod_settings, u32 chunk_tile_length)
+{
+	const u32 chunk_vertices_length = chunk_tile_length + 1;
+	const u32 vertices_count = chunk_vertices_length * chunk_vertices_length;
+
+	std::vector<u32> indices;
+
+	for (u32 lod_detail_index = 0; lod_detail_index < lod_settings->max_available_count; lod_detail_index++) {
+		const u32 detail = lod_settings->details[lod_detail_index];
+
+		// A LOD steps over the chunk's tiles detail at a time.
+		const u32 lod_length = (chunk_tile_length / detail) * detail;
+
+		LODDataInfo *info = &lod_settings->data_infos[lod_detail_index];
+		*info = {};
+
+		u64 offset = indices.size();
+
+		u32 v0, v1, v2, v3;
+
+		// The interior skips the first and last row and column of tiles,
+		// those are covered by the edge strips.
+		for (u32 j = detail; j + detail < lod_length; j += detail) {
+			for (u32 i = detail; i + detail < lod_length; i += detail) {
+				u32 index = j * chunk_vertices_length + i;
+
+				v0 = index;
+				v1 = v0 + detail;
+				v2 = v0 + (detail * chunk_vertices_length);
+				v3 = v2 + detail;
+
+				indices.push_back(v3); // Top-right
+				indices.push_back(v1); // Bottom-right
+				indices.push_back(v0); // Bottom-left
+				indices.push_back(v2); // Top-left
+				indices.push_back(v3);
+				indices.push_back(v0);
+			}
+		}
+
+		info->interior = end_lod_range(&indices, offset);
+
+		// One strip per edge for this LOD's detail and every coarser
+		// neighbour it might have to meet.
+		for (u32 edge = 0; edge < LOD_EDGE_COUNT; edge++) {
+			for (u32 neighbour = lod_detail_index; neighbour < lod_settings->max_available_count; neighbour++) {
+				offset = indices.size();
+				build_lod_edge(&indices, (LODEdge)edge, lod_length, chunk_vertices_length, detail, lod_settings->details[neighbour]);
+				info->edges[edge][neighbour] = end_lod_range(&indices, offset);
+			}
+		}
+
+		// Order the interior for the post-transform cache, every chunk draws
+		// it so it's done once per pattern. The strips are already in order.
+		u32 *interior = &indices[info->interior.offset];
+		std::vector<u32> row_major(interior, interior + info->interior.count);
+
+		std::vector<u32> lod_mesh;
+		for (u32 pass = 0; pass < 2; pass++) {
+			lod_mesh.assign(interior, interior + info->interior.count);
+			for (u32 edge = 0; edge < LOD_EDGE_COUNT; edge++) {
+				const IndexRange *range = &info->edges[edge][lod_detail_index];
+				lod_mesh.insert(lod_mesh.end(), &indices[range->offset], &indices[range->offset] + range->count);
+			}
+
+			if (pass == 0) {
+				info->acmr_unordered = vertex_cache_acmr(lod_mesh.data(), lod_mesh.size(), vertices_count);
+				vertex_cache_optimise(interior, info->interior.count, vertices_count);
+			} else {
+				info->acmr = vertex_cache_acmr(lod_mesh.data(), lod_mesh.size(), vertices_count);
+			}
+		}
+
+		// Small LODs already fit in the cache in row-major order, keep
+		// whichever order misses less.
+		if (info->acmr > info->acmr_unordered) {
+			std::copy(row_major.begin(), row_major.end(), interior);
+			info->acmr = info->acmr_unordered;
+		}
+
+		info->triangles_count = (u32)(lod_mesh.size() / 3);
+	}
+
+	lod_settings->indices_count = indices.size();
+
+	// Halve the indices when every vertex of the chunk fits in 16 bits.
+	if (vertices_count <= 65536) {
+		lod_settings->index_size = sizeof(u16);
+		lod_settings->indices16.assign(indices.begin(), indices.end());
+		lod_settings->indices16.shrink_to_fit();
+		indices.clear();
+	} else {
+		lod_settings->index_size = sizeof(u32);
+		lod_settings->indices16.clear();
+		lod_settings->indices16.shrink_to_fit();
+	}
+
+	lod_settings->indices.swap(indices);
+	lod_settings->indices.shrink_to_fit();
+}
+
+u32 lod_index(const LODSettings *lod_settings, u64 index)
+{
+	if (lod_settings->index_size == sizeof(u32)) {
+		return lod_settings->indices[index];
+	}
+
+	return lod_settings->indices16[index];
+}
+
+const void *lod_indices_data(const LODSettings *lod_settings)
+{
+	if (lod_settings->index_size == sizeof(u32)) {
+		return lod_settings->indices.data();
+	}
+
+	return lod_settings->indices16.data();
+}
+
+void lod_draw_ranges(const LODSettings *lod_settings, u32 lod_detail_index, const u32 *neighbour_lods, IndexRange *ranges)
+{
+	const LODDataInfo *info = &lod_settings->data_infos[lod_detail_index];
+
+	ranges[0] = info->interior;
+
+	for (u32 edge = 0; edge < LOD_EDGE_COUNT; edge++) {
+		u32 neighbour = lod_detail_index;
+
+		if (neighbour_lods && neighbour_lods[edge] > lod_detail_index) {
+			neighbour = neighbour_lods[edge];
+		}
+
+		ranges[1 + edge] = info->edges[edge][neighbour];
+	}
+}
+
+void init_lod_detail_levels(LODSettings *lod_settings, u32 chunk_tile_length)
+{
+	u32 detail = 1;
+	u32 multiplier = pow(2, lod_settings->detail_multiplier);
+
+	for (u32 i = 0; i < lod_settings->max_details_count; i++) {
+		lod_settings->details[i] = detail;
+		detail *= multiplier;
+	}
+
+	// Find the most LODs possible for the chunk size.
+	for (u32 i = 0; i < lod_settings->max_details_count; i++) {
+		lod_settings->max_available_count = i;
+
+		// Edge strips need at least two tiles across.
+		if (lod_settings->details[i] * 2 > chunk_tile_length) {
+			break;
+		}
+	}
+
+	lod_settings->details_in_use = 1;
+
+	build_lod_indices(lod_settings, chunk_tile_length);
+}
+
+void init_terrain(World *world, u32 chunk_tile_length, u32 world_width)
+{
+	// ---Terrain data.
+	world->params->chunk_tile_length = chunk_tile_length;
+	world->chunk_vertices_length = world->params->chunk_tile_length + 1;
+	world->params->world_width = world_width;
+	world->world_area = world->params->world_width * world->params->world_width;
+	world->world_tile_length = world->params->chunk_tile_length * world->params->world_width;
+	// ---End of terrain data.
+
+	// ---LOD settings
+	// detail_multiplier = n where 2^n = the rate of detail loss for each LOD level.
+	// e.g detail multiplier = 2
+	// LOD 0: quality: 1 / (2 ^ 2) * 0
+	// LOD 1: quality: 1 / (2 ^ 2) * 1
+	// LOD 2: quality: 1 / (2 ^ 2) * 2
+	// ...
+	world->lod_settings.detail_multiplier = 1;
+	world->lod_settings.max_detail_multiplier = 1;
+	world->lod_settings.max_pixel_error = 2.f;
+
+	// Calculate the maximum possible detail multiplier for the chunk size.
+	while (pow(2, 5 + world->lod_settings.max_detail_multiplier) <= world->params->chunk_tile_length) {
+		world->lod_settings.max_detail_multiplier++;
+	}
+
+	world->lod_settings.max_details_count = MAX_LOD_DETAILS;
+	world->lod_settings.details = (u32 *)malloc(world->lod_settings.max_details_count * sizeof(u32));
+
+	init_lod_detail_levels(&world->lod_settings, world->params->chunk_tile_length);
+	// ---end of LOD settings.
+
+	// The world field is rebuilt from scratch on the next generate.
+	world->field_length = world->world_tile_length + 1;
+	world->field_valid = false;
+
+	if (world->world_area > world->chunks.size()) {
+		u32 new_chunks = world->world_area - world->chunks.size();
+		while (new_chunks-- > 0) {
+			world->chunks.push_back(new Chunk());
+		}
+	}
+
+	world->chunk_count = 0;
+	for (u32 j = 0; j < world->params->world_width; j++) {
+		for (u32 i = 0; i < world->params->world_width; i++) {
+			u32 index = j * world->params->world_width + i;
+
+			u32 vertices_count = world->chunk_vertices_length * world->chunk_vertices_length;
+
+			// Reused chunks may have been bigger, give the memory back.
+			world->chunks[index]->vertices_count = vertices_count;
+			world->chunks[index]->vertices.resize(vertices_count);
+			world->chunks[index]->vertices.shrink_to_fit();
+			world->chunks[index]->vertices_by_height.resize(vertices_count);
+			world->chunks[index]->vertices_by_height.shrink_to_fit();
+			world->chunks[index]->x = i;
+			world->chunks[index]->y = j;
+
+			world->chunk_count++;
+		}
+	}
+}
+
+void free_world(World *world)
+{
+	for (Chunk *chunk : world->chunks) {
+		delete chunk;
+	}
+
+	world->chunks.clear();
+	world->chunk_count = 0;
+	world->world_area = 0;
+
+	free(world->lod_settings.details);
+	world->lod_settings.details = 0;
+}
+
+static NoiseFieldKey noise_field_key(World *world)
+{
+	const world_generation_parameters *params = world->params;
+
+	NoiseFieldKey key = {};
+	key.x_offset = params->x_offset;
+	key.z_offset = params->z_offset;
+	key.scale = params->scale;
+	key.lacunarity = params->lacunarity;
+	key.persistence = params->persistence;
+	key.chunk_tile_length = params->chunk_tile_length;
+	key.noise_revision = world->noise.revision;
+
+	return key;
+}
+
+static bool32 noise_field_key_equal(const NoiseFieldKey *a, const NoiseFieldKey *b)
+{
+	return a->x_offset == b->x_offset
+		&& a->z_offset == b->z_offset
+		&& a->scale == b->scale
+		&& a->lacunarity == b->lacunarity
+		&& a->persistence == b->persistence
+		&& a->chunk_tile_length == b->chunk_tile_length
+		&& a->noise_revision == b->noise_revision;
+}
+
+// Frequency and amplitude of an octave, stepped the same way as always so
+// the result doesn't depend on how the octaves were reached.
+static void octave_scales(const world_generation_parameters *params, s32 octave, real32 *frequency, real32 *amplitude)
+{
+	*frequency = 1;
+	*amplitude = 1;
+
+	for (s32 i = 0; i < octave; i++) {
+		*amplitude *= params->persistence;
+		*frequency *= params->lacunarity;
+	}
+}
+
+static real32 octaves_total_amplitude(const world_generation_parameters *params, s32 octaves)
+{
+	real32 amplitude = 1;
+	real32 total_amplitude = 0;
+
+	for (s32 i = 0; i < octaves; i++) {
+		total_amplitude += amplitude;
+		amplitude *= params->persistence;
+	}
+
+	return total_amplitude;
+}
+
+// Index of a chunk's first vertex in the world field, its rows are
+// field_length apart.
+static u64 chunk_field_offset(World *world, Chunk *chunk)
+{
+	return (u64)chunk->y * world->params->chunk_tile_length * world->field_length + (u64)chunk->x * world->params->chunk_tile_length;
+}
+
+// Adds (sign 1) or removes (sign -1) one octave of noise to the samples of the
+// world field the chunk owns. A chunk owns its window minus the last row and
+// column, which belong to the next chunk along, apart from at the world edge.
+static void accumulate_chunk_octave(World *world, Chunk *chunk, s32 octave, real64 sign)
+{
+	const world_generation_parameters *params = world->params;
+	const u32 length = world->chunk_vertices_length;
+
+	const u32 columns = chunk->x + 1 < params->world_width ? length - 1 : length;
+	const u32 rows = chunk->y + 1 < params->world_width ? length - 1 : length;
+
+	// One row of samples goes through the noise kernel at a time. The noise
+	// gradients are summed alongside so normals come straight out of the
+	// field too.
+	std::vector<real32> xs(columns), octave_xs(columns);
+	std::vector<real32> samples(columns), samples_dx(columns), samples_dy(columns);
+
+	real32 frequency, amplitude;
+	octave_scales(params, octave, &frequency, &amplitude);
+
+	// Each octave samples at frequency * x so its slope is scaled by it too.
+	const real32 slope_scale = amplitude * frequency;
+
+	for (u32 i = 0; i < columns; i++) {
+		xs[i] = params->x_offset + (chunk->x + (real32)i / params->chunk_tile_length) / params->scale;
+		octave_xs[i] = (real32)(frequency * xs[i]);
+	}
+
+	const u64 field_offset = chunk_field_offset(world, chunk);
+
+	for (u32 j = 0; j < rows; j++) {
+		real32 y = params->z_offset + (chunk->y + (real32)j / params->chunk_tile_length) / params->scale;
+
+		perlin_row(&world->noise, octave_xs.data(), (real32)(frequency * y), samples.data(), samples_dx.data(), samples_dy.data(), columns);
+
+		const u64 row = field_offset + (u64)j * world->field_length;
+		real64 *total = &world->field_total[row];
+		real64 *total_dx = &world->field_total_dx[row];
+		real64 *total_dy = &world->field_total_dy[row];
+
+		for (u32 i = 0; i < columns; i++) {
+			total[i] += sign * (real32)((0.5f + samples[i]) * amplitude);
+			total_dx[i] += sign * (real32)(samples_dx[i] * slope_scale);
+			total_dy[i] += sign * (real32)(samples_dy[i] * slope_scale);
+		}
+	}
+}
+
+// Brings the world field up to params->max_octaves.
+static void update_world_field(World *world)
+{
+	const NoiseFieldKey key = noise_field_key(world);
+	const s32 octaves = world->params->max_octaves > 0 ? world->params->max_octaves : 0;
+
+	if (!world->field_valid || !noise_field_key_equal(&world->field_key, &key)) {
+		const u64 samples = (u64)world->field_length * world->field_length;
+
+		world->field_total.assign(samples, 0);
+		world->field_total_dx.assign(samples, 0);
+		world->field_total_dy.assign(samples, 0);
+		world->field_octaves = 0;
+		world->field_key = key;
+		world->field_valid = true;
+	}
+
+	if (world->field_octaves == octaves) {
+		return;
+	}
+
+	// Only the octaves between the cached count and the new one cost
+	// anything, new ones are added and dropped ones subtracted back out.
+	const s32 from = world->field_octaves;
+
+	job_parallel_for(world->jobs, world->world_area, [world, from, octaves](u32 index) {
+		Chunk *chunk = world->chunks[index];
+
+		for (s32 octave = from; octave < octaves; octave++) {
+			accumulate_chunk_octave(world, chunk, octave, 1);
+		}
+
+		for (s32 octave = from - 1; octave >= octaves; octave--) {
+			accumulate_chunk_octave(world, chunk, octave, -1);
+		}
+	});
+
+	world->field_octaves = octaves;
+}
+
+// Turns the chunk's window of the world field into vertex heights and
+// normals, the only part that depends on y_scale and elevation_power.
+static void shape_chunk(World *world, Chunk *chunk)
+{
+	const world_generation_parameters *params = world->params;
+	const u32 length = world->chunk_vertices_length;
+	const real32 height_scale = params->y_scale * params->scale;
+
+	const real32 total_amplitude = octaves_total_amplitude(params, world->field_octaves);
+
+	// Noise space moves this much per tile in x and z.
+	const real32 noise_per_tile = 1.f / (params->chunk_tile_length * params->scale);
+	const real32 gradient_scale = noise_per_tile / total_amplitude;
+
+	const u64 field_offset = chunk_field_offset(world, chunk);
+
+	for (u32 j = 0; j < length; j++) {
+		const u64 row = field_offset + (u64)j * world->field_length;
+
+		for (u32 i = 0; i < length; i++) {
+			u32 index = j * length + i;
+
+			real32 octave_result = (real32)(world->field_total[row + i] / total_amplitude);
+
+			if (octave_result < 0) {
+				octave_result = 0;
+			}
+
+			const real32 shaped = powf(octave_result, params->elevation_power);
+			real32 elevation = (shaped * params->y_scale * params->scale);
+
+			// d(elevation)/d(octave_result) = p * r^(p - 1) * height, flat where
+			// the result is clamped.
+			real32 slope = 0;
+
+			if (octave_result > 0) {
+				slope = params->elevation_power * shaped / octave_result * height_scale;
+			}
+
+			const real32 dx = (real32)world->field_total_dx[row + i] * gradient_scale;
+			const real32 dz = (real32)world->field_total_dy[row + i] * gradient_scale;
+
+			chunk->vertices[index].height = elevation;
+			v3_oct_encode(v3_normalise({ -slope * dx, 1.f, -slope * dz }), chunk->vertices[index].normal);
+		}
+	}
+}
+
+V3 chunk_vertex_position(const World *world, const Chunk *chunk, u32 index)
+{
+	return {
+		(real32)(index % world->chunk_vertices_length),
+		chunk->vertices[index].height,
+		(real32)(index / world->chunk_vertices_length)
+	};
+}
+
+V3 chunk_vertex_normal(const Chunk *chunk, u32 index)
+{
+	return v3_oct_decode(chunk->vertices[index].normal);
+}
+
+// Largest height difference between the full grid and each LOD's grid of
+// tiles. The edge strips triangulate the border differently, the regular grid
+// is close enough to pick a LOD with. Each LOD's error is at least the one
+// before it so coarser never looks better.
+static void measure_chunk_lod_errors(World *world, Chunk *chunk)
+{
+	const LODSettings *lod_settings = &world->lod_settings;
+	const u32 length = world->chunk_vertices_length;
+	const u32 chunk_tile_length = world->params->chunk_tile_length;
+
+	chunk->min_height = chunk->max_height = chunk->vertices[0].height;
+
+	for (u32 index = 0; index < chunk->vertices_count; index++) {
+		const real32 height = chunk->vertices[index].height;
+		chunk->min_height = height < chunk->min_height ? height : chunk->min_height;
+		chunk->max_height = height > chunk->max_height ? height : chunk->max_height;
+	}
+
+	for (u32 lod_detail_index = 0; lod_detail_index < MAX_LOD_DETAILS; lod_detail_index++) {
+		chunk->lod_errors[lod_detail_index] = 0;
+	}
+
+	for (u32 lod_detail_index = 1; lod_detail_index < lod_settings->max_available_count; lod_detail_index++) {
+		const u32 detail = lod_settings->details[lod_detail_index];
+		const u32 lod_length = (chunk_tile_length / detail) * detail;
+		const real32 inverse_detail = 1.f / detail;
+
+		real32 error = chunk->lod_errors[lod_detail_index - 1];
+
+		for (u32 j = 0; j <= lod_length; j++) {
+			const u32 j0 = (j < lod_length ? j / detail : j / detail - 1) * detail;
+			const real32 w = (j - j0) * inverse_detail;
+
+			for (u32 i = 0; i <= lod_length; i++) {
+				const u32 i0 = (i < lod_length ? i / detail : i / detail - 1) * detail;
+				const real32 u = (i - i0) * inverse_detail;
+
+				const u32 v0 = j0 * length + i0;
+				const real32 h0 = chunk->vertices[v0].height; // Bottom-left
+				const real32 h1 = chunk->vertices[v0 + detail].height; // Bottom-right
+				const real32 h2 = chunk->vertices[v0 + detail * length].height; // Top-left
+				const real32 h3 = chunk->vertices[v0 + detail * length + detail].height; // Top-right
+
+				// Tiles are split along the bottom-left to top-right diagonal.
+				real32 lod_height;
+				if (u > w) {
+					lod_height = h0 + u * (h1 - h0) + w * (h3 - h1);
+				} else {
+					lod_height = h0 + w * (h2 - h0) + u * (h3 - h2);
+				}
+
+				const real32 difference = fabsf(chunk->vertices[j * length + i].height - lod_height);
+				error = difference > error ? difference : error;
+			}
+		}
+
+		chunk->lod_errors[lod_detail_index] = error;
+	}
+}
+
+// Heights as unsigned keys that sort in the same order as the floats.
+static u32 height_sort_key(real32 height)
+{
+	u32 bits;
+	memcpy(&bits, &height, sizeof(bits));
+
+	return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+}
+
+// Orders the chunk's vertices by height for placing features in height bands.
+// A radix sort of 11 bits a pass, stable so equal heights stay in index order.
+static void sort_chunk_vertices_by_height(Chunk *chunk)
+{
+	const u32 count = (u32)chunk->vertices_count;
+	const u32 radix_bits = 11;
+	const u32 radix_size = 1 << radix_bits;
+
+	std::vector<u32> keys(count), next_keys(count);
+	std::vector<u32> order(count), next_order(count);
+
+	for (u32 index = 0; index < count; index++) {
+		keys[index] = height_sort_key(chunk->vertices[index].height);
+		order[index] = index;
+	}
+
+	for (u32 shift = 0; shift < 32; shift += radix_bits) {
+		u32 offsets[radix_size] = {};
+
+		for (u32 index = 0; index < count; index++) {
+			offsets[(keys[index] >> shift) & (radix_size - 1)]++;
+		}
+
+		u32 offset = 0;
+		for (u32 digit = 0; digit < radix_size; digit++) {
+			const u32 digit_count = offsets[digit];
+			offsets[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (u32 index = 0; index < count; index++) {
+			const u32 to = offsets[(keys[index] >> shift) & (radix_size - 1)]++;
+			next_keys[to] = keys[index];
+			next_order[to] = order[index];
+		}
+
+		keys.swap(next_keys);
+		order.swap(next_order);
+	}
+
+	chunk->vertices_by_height.swap(order);
+}
+
+void generate_terrain_chunk(World *world, Chunk *chunk)
+{
+	shape_chunk(world, chunk);
+	measure_chunk_lod_errors(world, chunk);
+	sort_chunk_vertices_by_height(chunk);
+}
+
+void generate_terrain_chunks(World *world)
+{
+	update_world_field(world);
+
+	job_parallel_for(world->jobs, world->world_area, [world](u32 index) {
+		generate_terrain_chunk(world, world->chunks[index]);
+	});
+
+	const real32 chunk_tile_length = (real32)world->params->chunk_tile_length;
+
+	box_set_resize(&world->chunk_boxes, world->world_area);
+	world->min_height = world->chunks[0]->min_height;
+	world->max_height = world->chunks[0]->max_height;
+
+	for (u32 index = 0; index < world->world_area; index++) {
+		const Chunk *chunk = world->chunks[index];
+		const V3 min = { chunk->x * chunk_tile_length, chunk->min_height, chunk->y * chunk_tile_length };
+		const V3 max = { min.x + chunk_tile_length, chunk->max_height, min.z + chunk_tile_length };
+		box_set_store(&world->chunk_boxes, index, min, max);
+
+		world->min_height = chunk->min_height < world->min_height ? chunk->min_height : world->min_height;
+		world->max_height = chunk->max_height > world->max_height ? chunk->max_height : world->max_height;
+	}
+}
+
+void measure_lod_errors(World *world)
+{
+	job_parallel_for(world->jobs, world->world_area, [world](u32 index) {
+		measure_chunk_lod_errors(world, world->chunks[index]);
+	});
+}
+
+void world_memory_report(const World *world, WorldMemoryReport *report)
+{
+	*report = {};
+
+	const u32 lods_count = world->lod_settings.max_available_count;
+
+	report->chunk_vertices = (u64)world->chunk_vertices_length * world->chunk_vertices_length * (sizeof(ChunkVertex) + sizeof(u32));
+	report->chunk_total = sizeof(Chunk) + report->chunk_vertices;
+
+	for (u32 lod_detail_index = 0; lod_detail_index < lods_count; lod_detail_index++) {
+		const LODDataInfo *info = &world->lod_settings.data_infos[lod_detail_index];
+
+		u64 indices = info->interior.count;
+		for (u32 edge = 0; edge < LOD_EDGE_COUNT; edge++) {
+			for (u32 neighbour = lod_detail_index; neighbour < lods_count; neighbour++) {
+				indices += info->edges[edge][neighbour].count;
+			}
+		}
+
+		report->lod_indices[lod_detail_index] = indices * world->lod_settings.index_size;
+		report->lods += report->lod_indices[lod_detail_index];
+	}
+
+	report->terrain = report->chunk_total * world->world_area + report->lods;
+	report->field = (u64)world->field_length * world->field_length * 3 * sizeof(real64);
+	report->features = ((u64)world->params->tree_count + world->params->rock_count) * (6 * sizeof(real32) + sizeof(FeatureInstance));
+	report->features += 2 * ((u64)world->world_area + 1) * sizeof(u32);
+	report->total = report->terrain + report->field + report->features;
+}
+
+static FeatureInstance feature_instance(V3 pos, V3 rotation)
+{
+	real32 model[16];
+	mat4_identity(model);
+	mat4_translate(model, pos.x, pos.y, pos.z);
+	mat4_rotate_x(model, rotation.x);
+	mat4_rotate_y(model, rotation.y);
+	mat4_rotate_z(model, rotation.z);
+
+	// Rows of the column major matrix.
+	FeatureInstance instance;
+
+	for (u32 row = 0; row < 3; row++) {
+		instance.rows[row] = { model[row], model[4 + row], model[8 + row], model[12 + row] };
+	}
+
+	return instance;
+}
+
+struct FeaturePlacement {
+	u32 chunk;
+	V3 pos;
+	V3 rotation;
+};
+
+// Buckets the placements by chunk with a counting sort, keeping their order
+// within each chunk.
+static void store_features(World *world, FeatureStore *features, const std::vector<FeaturePlacement> *placements)
+{
+	const u32 count = (u32)placements->size();
+
+	features->chunk_starts.assign(world->world_area + 1, 0);
+
+	for (const FeaturePlacement &placement : *placements) {
+		features->chunk_starts[placement.chunk + 1]++;
+	}
+
+	for (u32 chunk = 0; chunk < world->world_area; chunk++) {
+		features->chunk_starts[chunk + 1] += features->chunk_starts[chunk];
+	}
+
+	features->x.resize(count);
+	features->y.resize(count);
+	features->z.resize(count);
+	features->rotation_x.resize(count);
+	features->rotation_y.resize(count);
+	features->rotation_z.resize(count);
+	features->instances.resize(count);
+	features->count = count;
+
+	std::vector<u32> next(features->chunk_starts.begin(), features->chunk_starts.end() - 1);
+
+	for (const FeaturePlacement &placement : *placements) {
+		const u32 index = next[placement.chunk]++;
+
+		features->x[index] = placement.pos.x;
+		features->y[index] = placement.pos.y;
+		features->z[index] = placement.pos.z;
+		features->rotation_x[index] = placement.rotation.x;
+		features->rotation_y[index] = placement.rotation.y;
+		features->rotation_z[index] = placement.rotation.z;
+		features->instances[index] = feature_instance(placement.pos, placement.rotation);
+	}
+}
+
+// The chunk vertices with a height in [min_height, max_height]. Each chunk's
+// are a range of its vertices_by_height starting at firsts, and ends holds the
+// running total across chunks to share features out by. Only the ranges
+// depend on the band, the height order doesn't.
+struct HeightBand {
+	std::vector<u32> firsts;
+	std::vector<u64> ends;
+	u64 total;
+};
+
+static void build_height_band(World *world, real32 min_height, real32 max_height, HeightBand *band)
+{
+	band->firsts.resize(world->world_area);
+	band->ends.resize(world->world_area);
+
+	job_parallel_for(world->jobs, world->world_area, [world, min_height, max_height, band](u32 index) {
+		const Chunk *chunk = world->chunks[index];
+		const ChunkVertex *vertices = chunk->vertices.data();
+
+		if (max_height < min_height || chunk->max_height < min_height || chunk->min_height > max_height) {
+			band->firsts[index] = 0;
+			band->ends[index] = 0;
+			return;
+		}
+
+		const auto first = std::lower_bound(chunk->vertices_by_height.begin(), chunk->vertices_by_height.end(), min_height, [vertices](u32 vertex, real32 height) {
+			return vertices[vertex].height < height;
+		});
+		const auto last = std::upper_bound(first, chunk->vertices_by_height.end(), max_height, [vertices](real32 height, u32 vertex) {
+			return height < vertices[vertex].height;
+		});
+
+		band->firsts[index] = (u32)(first - chunk->vertices_by_height.begin());
+		band->ends[index] = (u64)(last - first);
+	});
+
+	for (u32 index = 1; index < world->world_area; index++) {
+		band->ends[index] += band->ends[index - 1];
+	}
+
+	band->total = world->world_area > 0 ? band->ends[world->world_area - 1] : 0;
+}
+
+// The chunk's share of count features by its share of the band. Rounding the
+// running totals gives every chunk a whole number that add up to count.
+static u32 height_band_share(const HeightBand *band, u32 count, u32 chunk_index)
+{
+	const u64 chunk_start = chunk_index > 0 ? band->ends[chunk_index - 1] : 0;
+	const u64 share_start = (u64)((real64)count * chunk_start / band->total + 0.5);
+	const u64 share_end = (u64)((real64)count * band->ends[chunk_index] / band->total + 0.5);
+
+	return (u32)(share_end - share_start);
+}
+
+// Eligible vertices in the chunk.
+static u32 height_band_count(const HeightBand *band, u32 chunk_index)
+{
+	const u64 chunk_start = chunk_index > 0 ? band->ends[chunk_index - 1] : 0;
+
+	return (u32)(band->ends[chunk_index] - chunk_start);
+}
+
+// A chunk's trees. grid covers the chunk in cells small enough to hold one
+// tree each, with the tree's index plus one or 0 when empty.
+struct ChunkTrees {
+	std::vector<u32> vertices;
+	std::vector<real32> rotations;
+	std::vector<u32> grid;
+};
+
+struct TreeSpacing {
+	real32 spacing; // Least distance between trees, in tiles.
+	real32 cell_size;
+	u32 grid_length; // Cells along each side of a chunk.
+};
+
+// Chunks are placed in four phases by the parity of their x and y, so no two
+// chunks of a phase touch, even at a corner, and every chunk sees the final
+// trees of the neighbours placed in earlier phases.
+#define TREE_PHASE_COUNT 4
+
+static u32 chunk_tree_phase(const Chunk *chunk)
+{
+	return (chunk->x & 1) | ((chunk->y & 1) << 1);
+}
+
+// Whether a tree lies within spacing of x, z, relative to the corner of the
+// trees' chunk.
+static bool32 tree_too_close(const World *world, const ChunkTrees *trees, const TreeSpacing *spacing, real32 x, real32 z)
+{
+	const real32 chunk_tile_length = (real32)world->params->chunk_tile_length;
+	const real32 r = spacing->spacing;
+
+	if (x + r < 0 || z + r < 0 || x - r > chunk_tile_length || z - r > chunk_tile_length) {
+		return false;
+	}
+
+	const u32 last_cell = spacing->grid_length - 1;
+	const u32 cell_x0 = x - r > 0 ? (u32)((x - r) / spacing->cell_size) : 0;
+	const u32 cell_z0 = z - r > 0 ? (u32)((z - r) / spacing->cell_size) : 0;
+	const u32 cell_x1 = std::min((u32)((x + r) / spacing->cell_size), last_cell);
+	const u32 cell_z1 = std::min((u32)((z + r) / spacing->cell_size), last_cell);
+
+	for (u32 cell_z = cell_z0; cell_z <= cell_z1; cell_z++) {
+		for (u32 cell_x = cell_x0; cell_x <= cell_x1; cell_x++) {
+			const u32 tree = trees->grid[cell_z * spacing->grid_length + cell_x];
+
+			if (tree == 0) {
+				continue;
+			}
+
+			const u32 vertex = trees->vertices[tree - 1];
+			const real32 dx = (real32)(vertex % world->chunk_vertices_length) - x;
+			const real32 dz = (real32)(vertex / world->chunk_vertices_length) - z;
+
+			if (dx * dx + dz * dz < r * r) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Whether x, z in the chunk is within spacing of a tree in the chunk or in a
+// neighbour from an earlier phase. Neighbours of later phases are still
+// being placed and check against this chunk instead.
+static bool32 chunk_tree_too_close(const World *world, const std::vector<ChunkTrees> *all_trees, const TreeSpacing *spacing, u32 chunk_index, real32 x, real32 z)
+{
+	const Chunk *chunk = world->chunks[chunk_index];
+	const u32 world_width = world->params->world_width;
+	const real32 chunk_tile_length = (real32)world->params->chunk_tile_length;
+	const real32 r = spacing->spacing;
+
+	if (tree_too_close(world, &(*all_trees)[chunk_index], spacing, x, z)) {
+		return true;
+	}
+
+	if (x >= r && z >= r && x <= chunk_tile_length - r && z <= chunk_tile_length - r) {
+		return false;
+	}
+
+	const u32 phase = chunk_tree_phase(chunk);
+
+	for (s32 dy = -1; dy <= 1; dy++) {
+		for (s32 dx = -1; dx <= 1; dx++) {
+			const s32 neighbour_x = (s32)chunk->x + dx;
+			const s32 neighbour_y = (s32)chunk->y + dy;
+
+			if (neighbour_x < 0 || neighbour_y < 0 || neighbour_x >= (s32)world_width || neighbour_y >= (s32)world_width) {
+				continue;
+			}
+
+			const u32 neighbour = (u32)neighbour_y * world_width + (u32)neighbour_x;
+
+			if (chunk_tree_phase(world->chunks[neighbour]) >= phase) {
+				continue;
+			}
+
+			if (tree_too_close(world, &(*all_trees)[neighbour], spacing, x - dx * chunk_tile_length, z - dy * chunk_tile_length)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Poisson disk sampling of the chunk's vertices in the tree height band by
+// dart throwing, its share of the trees going to its share of the band.
+static void place_chunk_trees(World *world, const HeightBand *band, const TreeSpacing *spacing, u32 chunk_index, std::vector<ChunkTrees> *all_trees)
+{
+	const Chunk *chunk = world->chunks[chunk_index];
+	ChunkTrees *trees = &(*all_trees)[chunk_index];
+
+	trees->vertices.clear();
+	trees->rotations.clear();
+	trees->grid.assign((u64)spacing->grid_length * spacing->grid_length, 0);
+
+	// No more trees than vertices, trying for more would only burn attempts.
+	const u32 eligible = height_band_count(band, chunk_index);
+	const u32 target = std::min(height_band_share(band, world->params->tree_count, chunk_index), eligible);
+
+	if (target == 0 || eligible == 0) {
+		return;
+	}
+
+	RandomStream stream = random_stream(world->params->seed, RANDOM_TREES, chunk->x, chunk->y);
+	const u32 max_attempts = target * 30;
+
+	// As many misses in a row as there are vertices means the chunk is all
+	// but full, the few places left aren't worth searching for.
+	u32 misses = 0;
+
+	for (u32 attempt = 0; attempt < max_attempts && misses < eligible && trees->vertices.size() < target; attempt++) {
+		const u32 vertex = chunk->vertices_by_height[band->firsts[chunk_index] + random_below(&stream, eligible)];
+		const real32 x = (real32)(vertex % world->chunk_vertices_length);
+		const real32 z = (real32)(vertex / world->chunk_vertices_length);
+
+		if (chunk_tree_too_close(world, all_trees, spacing, chunk_index, x, z)) {
+			misses++;
+			continue;
+		}
+
+		misses = 0;
+
+		const u32 cell_x = (u32)(x / spacing->cell_size);
+		const u32 cell_z = (u32)(z / spacing->cell_size);
+		trees->grid[cell_z * spacing->grid_length + cell_x] = (u32)trees->vertices.size() + 1;
+		trees->vertices.push_back(vertex);
+		trees->rotations.push_back(random_range(&stream, 0.f, 360.f));
+	}
+}
+
+void generate_trees(World *world)
+{
+	std::vector<FeaturePlacement> placements;
+
+	HeightBand band;
+	build_height_band(world, (real32)world->params->tree_min_height, (real32)world->params->tree_max_height, &band);
+
+	if (band.total == 0 || world->params->tree_count == 0) {
+		store_features(world, &world->trees, &placements);
+		return;
+	}
+
+	// Each eligible vertex stands for a tile of ground. Random dart throwing
+	// jams at about 0.7 / spacing^2 trees per tile, so this leaves room to
+	// place them all. Vertices are a tile apart though, and just over a tile
+	// already rules out the four nearest vertices, so denser forests drop to
+	// a spacing of one, which only stops two trees sharing a vertex. That
+	// caps the trees at one per eligible vertex.
+	TreeSpacing spacing;
+	spacing.spacing = 0.7f * sqrtf((real32)band.total / world->params->tree_count);
+	spacing.spacing = spacing.spacing < 1.3f ? 1.f : spacing.spacing;
+	spacing.cell_size = spacing.spacing * 0.7f; // Just under spacing / sqrt(2).
+	spacing.grid_length = (u32)(world->params->chunk_tile_length / spacing.cell_size) + 1;
+
+	std::vector<u32> phase_chunks[TREE_PHASE_COUNT];
+	for (u32 index = 0; index < world->world_area; index++) {
+		phase_chunks[chunk_tree_phase(world->chunks[index])].push_back(index);
+	}
+
+	std::vector<ChunkTrees> trees(world->world_area);
+
+	for (u32 phase = 0; phase < TREE_PHASE_COUNT; phase++) {
+		const std::vector<u32> *chunks = &phase_chunks[phase];
+
+		job_parallel_for(world->jobs, (u32)chunks->size(), [world, &band, &spacing, chunks, &trees](u32 index) {
+			place_chunk_trees(world, &band, &spacing, (*chunks)[index], &trees);
+		});
+	}
+
+	const u32 chunk_tile_length = world->params->chunk_tile_length;
+
+	for (u32 index = 0; index < world->world_area; index++) {
+		const Chunk *chunk = world->chunks[index];
+
+		for (u32 tree = 0; tree < trees[index].vertices.size(); tree++) {
+			const V3 pos = chunk_vertex_position(world, chunk, trees[index].vertices[tree]);
+			const V3 world_pos = { chunk->x * chunk_tile_length + pos.x, pos.y, chunk->y * chunk_tile_length + pos.z };
+
+			placements.push_back({ index, world_pos, { 0.f, trees[index].rotations[tree], 0.f } });
+		}
+	}
+
+	store_features(world, &world->trees, &placements);
+}
+
+// Rocks don't need spacing out, the chunk's share of them go on vertices
+// drawn from its part of the rock height band.
+static void place_chunk_rocks(World *world, const HeightBand *band, u32 chunk_index, std::vector<FeaturePlacement> *placements)
+{
+	const Chunk *chunk = world->chunks[chunk_index];
+	const u32 chunk_tile_length = world->params->chunk_tile_length;
+	const u32 count = height_band_share(band, world->params->rock_count, chunk_index);
+	const u32 eligible = height_band_count(band, chunk_index);
+
+	placements->clear();
+
+	if (count == 0 || eligible == 0) {
+		return;
+	}
+
+	RandomStream stream = random_stream(world->params->seed, RANDOM_ROCKS, chunk->x, chunk->y);
+
+	for (u32 i = 0; i < count; i++) {
+		const u32 vertex = chunk->vertices_by_height[band->firsts[chunk_index] + random_below(&stream, eligible)];
+		const V3 pos = chunk_vertex_position(world, chunk, vertex);
+		const V3 nor = chunk_vertex_normal(chunk, vertex);
+
+		const V3 world_pos = { chunk->x * chunk_tile_length + pos.x, pos.y, chunk->y * chunk_tile_length + pos.z };
+		const V3 rotation = {
+			(acosf(v3_dot(nor, { 1, 0, 0 })) * 180.f / (real32)M_PI),
+			random_range(&stream, 0.f, 360.f),
+			(acosf(v3_dot(nor, { 0, 0, 1 })) * 180.f / (real32)M_PI)
+		};
+
+		placements->push_back({ chunk_index, world_pos, rotation });
+	}
+}
+
+void generate_rocks(World *world)
+{
+	std::vector<FeaturePlacement> placements;
+
+	HeightBand band;
+	build_height_band(world, (real32)world->params->rock_min_height, (real32)world->params->rock_max_height, &band);
+
+	if (band.total == 0 || world->params->rock_count == 0) {
+		store_features(world, &world->rocks, &placements);
+		return;
+	}
+
+	std::vector<std::vector<FeaturePlacement>> chunk_placements(world->world_area);
+	job_parallel_for(world->jobs, world->world_area, [world, &band, &chunk_placements](u32 index) {
+		place_chunk_rocks(world, &band, index, &chunk_placements[index]);
+	});
+
+	placements.reserve(world->params->rock_count);
+	for (const std::vector<FeaturePlacement> &chunk_rocks : chunk_placements) {
+		placements.insert(placements.end(), chunk_rocks.begin(), chunk_rocks.end());
+	}
+
+	store_features(world, &world->rocks, &placements);
+}
@@ -0,0 +1,274 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <string>
+
+#include "types.h"
+#include "maths.h"
+#include "jobs.h"
+#include "perlin.h"
+#include "frustum.h"
+
+// A tree or rock's translation and rotation as the top three rows of its
+// model matrix, packed for instanced drawing. The size is applied separately
+// so resizing doesn't need them rebuilt.
+struct FeatureInstance {
+    V4 rows[3];
+};
+
+// Trees or rocks bucketed by the chunk they stand on, in structure of arrays
+// layout. Chunk c's features are [chunk_starts[c], chunk_starts[c + 1]) so
+// culling and export can take a chunk at a time.
+struct FeatureStore {
+    std::vector<real32> x, y, z;
+    std::vector<real32> rotation_x, rotation_y, rotation_z; // Degrees.
+    std::vector<FeatureInstance> instances;
+    std::vector<u32> chunk_starts; // world_area + 1 entries.
+    u32 count;
+};
+
+inline V3 feature_position(const FeatureStore *features, u32 index)
+{
+    return { features->x[index], features->y[index], features->z[index] };
+}
+
+inline V3 feature_rotation(const FeatureStore *features, u32 index)
+{
+    return { features->rotation_x[index], features->rotation_y[index], features->rotation_z[index] };
+}
+
+// The layout of this struct is the .world preset file format, only ever
+// append new fields to the end.
+struct world_generation_parameters {
+    real32 x_offset;
+    real32 z_offset;
+    real32 scale;
+    real32 lacunarity;
+    real32 persistence;
+    real32 elevation_power;
+    real32 y_scale;
+    real32 sand_height;
+    real32 stone_height;
+    real32 snow_height;
+    real32 ambient_strength;
+    real32 diffuse_strength;
+    real32 specular_strength;
+    real32 gamma_correction;
+    real32 rock_size;
+    real32 tree_size;
+    V3 water_pos;
+    V3 ground_colour;
+    V3 sand_colour;
+    V3 stone_colour;
+    V3 snow_colour;
+    V3 slope_colour;
+    V3 water_colour;
+    V3 light_colour;
+    V3 skybox_colour;
+    V3 rock_colour;
+    V3 trunk_colour;
+    V3 leaves_colour;
+    s32 max_octaves;
+    u32 chunk_tile_length;
+    u32 world_width;
+    u32 seed;
+    u32 tree_count; // Requested, no more than one per vertex in the tree height band fits.
+    u32 tree_min_height;
+    u32 tree_max_height;
+    u32 rock_count;
+    u32 rock_min_height;
+    u32 rock_max_height;
+};
+
+struct preset_file {
+    std::string name;
+    u32 index;
+    world_generation_parameters params;
+};
+
+struct Vertex {
+    V3 pos;
+    V3 nor;
+};
+
+// A chunk's grid point. x and z are the column and row of the vertex so only
+// the height and an octahedral encoded normal are kept, rebuilt with
+// chunk_vertex_position and chunk_vertex_normal on the CPU and from
+// gl_VertexID in the terrain shaders.
+struct ChunkVertex {
+    real32 height;
+    s16 normal[2];
+};
+
+#define MAX_LOD_DETAILS 10
+
+enum LODEdge {
+    LOD_EDGE_BOTTOM, // z = 0
+    LOD_EDGE_RIGHT,
+    LOD_EDGE_TOP,
+    LOD_EDGE_LEFT, // x = 0
+    LOD_EDGE_COUNT
+};
+
+// Interior first, then one strip per edge.
+#define LOD_DRAW_RANGES_COUNT (1 + LOD_EDGE_COUNT)
+
+// A run of triangles in the shared LOD indices.
+struct IndexRange {
+    u64 offset; // In indices from the start of the LOD indices.
+    u32 count;
+};
+
+// A LOD is its interior plus a strip along each edge. Every edge has a strip
+// for each LOD at least as coarse as this one, edges[edge][neighbour], which
+// steps down to the neighbour's vertices so there are no T-junction cracks.
+// The strip for this LOD itself meets a neighbour of the same detail.
+struct LODDataInfo {
+    IndexRange interior;
+    IndexRange edges[LOD_EDGE_COUNT][MAX_LOD_DETAILS];
+    u32 triangles_count; // The interior and this LOD's own strips.
+    real32 acmr_unordered; // Cache misses per triangle in row-major order.
+    real32 acmr; // And after ordering for the vertex cache.
+};
+
+// Everything the raw fBm field depends on apart from the octave count. The
+// remaining parameters only shape the field into heights.
+struct NoiseFieldKey {
+    real32 x_offset;
+    real32 z_offset;
+    real32 scale;
+    real32 lacunarity;
+    real32 persistence;
+    u32 chunk_tile_length;
+    u32 noise_revision;
+};
+
+struct Chunk {
+    std::vector<ChunkVertex> vertices;
+    std::vector<u32> vertices_by_height; // Vertex indices, lowest first, so a height band is one range.
+    u64 vertices_count;
+    u32 x, y;
+    u32 vbo;
+
+    real32 min_height, max_height;
+    real32 lod_errors[MAX_LOD_DETAILS]; // Largest height error of each LOD.
+};
+
+struct LODSettings {
+    u32 *details;
+    u32 max_details_count; // Size of the array
+    u32 max_available_count; // Number of possible LODs for the chunk size.
+    u32 max_detail_multiplier; // The maximum multiplier to generate details.
+    u32 details_in_use; // Current amount of LODs being used.
+    u32 detail_multiplier;
+    real32 max_pixel_error; // Height error a LOD may show on screen, in pixels.
+
+    // Triangles for every available LOD, shared by all chunks since they only
+    // depend on the chunk size. Rebuilt by init_lod_detail_levels. Chunks
+    // with at most 65536 vertices keep 16-bit indices in indices16 instead.
+    std::vector<u32> indices;
+    std::vector<u16> indices16;
+    LODDataInfo data_infos[MAX_LOD_DETAILS];
+    u64 indices_count;
+    u32 index_size; // Bytes per index, 2 or 4.
+    u32 ebo;
+};
+
+// Everything needed to generate a world, free of any window or GL state so it
+// can run headless. params and jobs are owned by the caller, jobs may be null
+// to generate on the calling thread.
+struct World {
+    world_generation_parameters *params;
+    JobSystem *jobs;
+
+    NoiseContext noise; // Seeded from params->seed by the caller.
+
+    // Running fBm sums over the first field_octaves octaves, with their
+    // gradients, for every vertex of the world. Samples on chunk borders are
+    // evaluated once by the chunk that owns them and every chunk reads its
+    // chunk_vertices_length^2 window from here. Changing y_scale or
+    // elevation_power reshapes the chunks from these without touching the
+    // noise, and changing the octave count only adds or subtracts the octaves
+    // in between. Kept in double so taking an octave back out leaves the sum
+    // never having added it would, to within rounding far below what the
+    // float heights can show. Adding and removing octaves again and again
+    // can still drift, reseeding or changing the field key starts over.
+    std::vector<real64> field_total;
+    std::vector<real64> field_total_dx;
+    std::vector<real64> field_total_dy;
+    u32 field_length; // Samples per row, world_tile_length + 1.
+    s32 field_octaves;
+    NoiseFieldKey field_key;
+    bool32 field_valid;
+
+    LODSettings lod_settings;
+    std::vector<Chunk*> chunks;
+    BoxSet chunk_boxes; // Each chunk's bounds in world space, by index.
+    real32 min_height, max_height; // Over every chunk.
+    FeatureStore trees, rocks;
+    u32 chunk_count;
+    u32 chunk_vertices_length;
+    u32 world_area;
+    u32 world_tile_length;
+};
+
+// Bytes a world of the current size holds, worked out from its dimensions so it
+// can be asked for straight after init_terrain to budget a world before
+// generating it. Features are counted at the requested tree and rock counts,
+// an upper bound as fewer may fit in their height bands.
+struct WorldMemoryReport {
+    u64 chunk_vertices;   // One chunk's vertices and their height order.
+    u64 chunk_total;      // One chunk including its bookkeeping.
+    u64 lod_indices[MAX_LOD_DETAILS]; // Indices for each LOD, shared by every chunk.
+    u64 lods;             // Indices for all LODs.
+    u64 terrain;          // Every chunk and the LOD indices.
+    u64 field;            // The world fBm field and its gradients.
+    u64 features;         // Tree and rock transforms.
+    u64 total;
+};
+
+extern bool32 load_preset_file(const std::string &filename, preset_file *p_file);
+extern bool32 save_preset_file(const std::string &filename, preset_file *p_file);
+
+extern void init_lod_detail_levels(LODSettings *lod_settings, u32 chunk_tile_length);
+extern void init_terrain(World *world, u32 chunk_tile_length, u32 world_width);
+// Gives back the chunks and LOD details init_terrain allocated. The world
+// itself, params and jobs stay the caller's.
+extern void free_world(World *world);
+
+// A LOD index widened to 32 bits, and the raw indices to upload.
+extern u32 lod_index(const LODSettings *lod_settings, u64 index);
+extern const void *lod_indices_data(const LODSettings *lod_settings);
+
+// The ranges that draw a chunk at a LOD next to neighbours at the given LODs,
+// indexed by LODEdge, or null when they all match. A finer neighbour stitches
+// to the chunk itself so only coarser ones change its strips.
+extern void lod_draw_ranges(const LODSettings *lod_settings, u32 lod_detail_index, const u32 *neighbour_lods, IndexRange *ranges);
+extern void world_memory_report(const World *world, WorldMemoryReport *report);
+
+// Position relative to the chunk's corner and normal of a chunk vertex.
+extern V3 chunk_vertex_position(const World *world, const Chunk *chunk, u32 index);
+extern V3 chunk_vertex_normal(const Chunk *chunk, u32 index);
+
+// Builds a chunk's vertices from the world field, which generate_terrain_chunks
+// brings up to date first, then updates chunk_boxes.
+extern void generate_terrain_chunk(World *world, Chunk *chunk);
+extern void generate_terrain_chunks(World *world);
+
+// Remeasures every chunk's LOD errors after the details change.
+extern void measure_lod_errors(World *world);
+
+// Spaces tree_count trees out over the tree height band. Each chunk places
+// its trees from its own random stream, after the neighbours it checks the
+// spacing against, so the result doesn't depend on the number of threads.
+// It isn't local though: the spacing and every chunk's share of tree_count
+// come from the whole world's band, and a chunk's trees shape those of the
+// neighbours placed after it, so changing one chunk's heights can move trees
+// anywhere. Only rebuilding all of them gives a consistent forest.
+extern void generate_trees(World *world);
+// Shares rock_count rocks out over the rock height band the same way, with
+// no spacing.
+extern void generate_rocks(World *world);
+
+#endif